@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Synthetic solver dumps in the shapes that stress different parts of the loader.
+ *
+ * Every node carries a solver comment like the real dumps, so the comment
+ * fields are parsed too. The output only depends on the arguments and the seed.
+ */
+class SGFGenerator {
+public:
+    explicit SGFGenerator(uint32_t seed = 1) : rng_(seed) {}
+
+    /**
+     * @brief An OR root with `width` variations of `length` nodes each.
+     */
+    std::string wideOrRoot(size_t width, size_t length)
+    {
+        std::string sgf = "(";
+        appendNode(sgf, 'B', randomMove(), 0);
+        for (size_t v = 0; v < width; ++v) {
+            sgf += '(';
+            for (size_t i = 0; i < length; ++i) {
+                appendNode(sgf, i % 2 == 0 ? 'W' : 'B', randomMove(), 0);
+            }
+            sgf += ")\n";
+        }
+        sgf += ')';
+        return sgf;
+    }
+
+    /**
+     * @brief A single line of `depth` nodes.
+     */
+    std::string deepLine(size_t depth)
+    {
+        std::string sgf = "(";
+        for (size_t i = 0; i < depth; ++i) {
+            appendNode(sgf, i % 2 == 0 ? 'B' : 'W', randomMove(), 0);
+        }
+        sgf += ')';
+        return sgf;
+    }
+
+    /**
+     * @brief A random tree of about `num_nodes` nodes whose comments are padded to `comment_size` bytes.
+     */
+    std::string commentHeavy(size_t num_nodes, size_t comment_size)
+    {
+        std::string sgf = "(";
+        size_t count = 0;
+        appendRandomTree(sgf, 'B', 0, num_nodes, comment_size, count);
+        sgf += ')';
+        return sgf;
+    }
+
+    /**
+     * @brief All orderings of `depth` moves out of `num_moves`, so most positions are reached many times.
+     *
+     * The first path to a position is expanded, later ones are transposition
+     * hits (match_tt = true) without children, like the solver writes them.
+     */
+    std::string transpositionHeavy(size_t num_moves, size_t depth)
+    {
+        std::vector<std::string> moves;
+        while (moves.size() < num_moves) {
+            std::string move = randomMove();
+            if (std::find(moves.begin(), moves.end(), move) == moves.end()) {
+                moves.push_back(move);
+            }
+        }
+        std::set<std::vector<size_t>> seen;
+        std::vector<size_t> played;
+        std::string sgf = "(;GN[transpositions]";
+        appendPermutations(sgf, moves, depth, played, seen);
+        sgf += ')';
+        return sgf;
+    }
+
+    /**
+     * @brief A random tree with the mix of branching, comments and labels of real dumps.
+     */
+    std::string mixed(size_t num_nodes)
+    {
+        return commentHeavy(num_nodes, 64);
+    }
+
+private:
+    std::string randomMove()
+    {
+        std::uniform_int_distribution<int> coordinate(0, 18);
+        return {static_cast<char>('a' + coordinate(rng_)), static_cast<char>('a' + coordinate(rng_))};
+    }
+
+    void appendNode(std::string& sgf, char color, const std::string& move, size_t comment_size, bool match_tt = false)
+    {
+        bool solved = match_tt || std::uniform_real_distribution<double>(0, 1)(rng_) < 0.7;
+        sgf += ';';
+        sgf += color;
+        sgf += '[' + move + "]C[solver_status: ";
+        sgf += solved ? (rng_() % 2 == 0 ? "WIN" : "LOSS") : "UNKNOWN";
+        sgf += match_tt ? "\nmatch_tt = true" : "\nmatch_tt = false";
+        sgf += "\nequal_loss = -1\nnodes = ";
+        sgf += std::to_string(rng_() % 100000);
+        if (comment_size > 0) {
+            sgf += "\nnote: ";
+            for (size_t i = 0; i < comment_size; ++i) {
+                sgf += static_cast<char>('a' + i % 26);
+            }
+        }
+        sgf += ']';
+        if (rng_() % 4 == 0) {
+            sgf += "LB[aa:1][bb:2]";
+        }
+    }
+
+    void appendRandomTree(std::string& sgf, char color, size_t depth, size_t num_nodes, size_t comment_size, size_t& count)
+    {
+        appendNode(sgf, color, randomMove(), comment_size);
+        ++count;
+        static const size_t branching[] = {0, 1, 1, 1, 2, 2, 3, 5};
+        size_t k = depth == 0 ? 8 : branching[rng_() % 8];
+        if (depth > 60) {
+            k = 0;
+        }
+        char other = color == 'B' ? 'W' : 'B';
+        if (k == 1) {
+            if (count < num_nodes) {
+                appendRandomTree(sgf, other, depth + 1, num_nodes, comment_size, count);
+            }
+            return;
+        }
+        for (size_t i = 0; i < k && count < num_nodes; ++i) {
+            sgf += '(';
+            appendRandomTree(sgf, other, depth + 1, num_nodes, comment_size, count);
+            sgf += ")\n";
+        }
+    }
+
+    void appendPermutations(std::string& sgf, const std::vector<std::string>& moves, size_t depth, std::vector<size_t>& played, std::set<std::vector<size_t>>& seen)
+    {
+        if (played.size() == depth) {
+            return;
+        }
+        char color = played.size() % 2 == 0 ? 'B' : 'W';
+        std::vector<size_t> children;
+        for (size_t m = 0; m < moves.size(); ++m) {
+            if (std::find(played.begin(), played.end(), m) == played.end()) {
+                children.push_back(m);
+            }
+        }
+        for (size_t m : children) {
+            // the position is the set of moves of each color
+            played.push_back(m);
+            std::vector<size_t> black, white;
+            for (size_t i = 0; i < played.size(); ++i) {
+                (i % 2 == 0 ? black : white).push_back(played[i]);
+            }
+            std::sort(black.begin(), black.end());
+            std::sort(white.begin(), white.end());
+            std::vector<size_t> position = black;
+            position.push_back(moves.size()); // separator
+            position.insert(position.end(), white.begin(), white.end());
+            bool hit = !seen.insert(position).second;
+
+            sgf += '(';
+            appendNode(sgf, color, moves[m], 0, hit);
+            if (!hit) {
+                appendPermutations(sgf, moves, depth, played, seen);
+            }
+            sgf += ')';
+            played.pop_back();
+        }
+    }
+
+    std::mt19937 rng_;
+};
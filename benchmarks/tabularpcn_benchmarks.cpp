@@ -0,0 +1,298 @@
+// Benchmarks of the SGF lexer, parser, loader and tree passes on synthetic inputs.
+//
+// Machine-readable results: tabularpcn_benchmarks --benchmark_format=json (or
+// --benchmark_out=results.json). Set TABULARPCN_BENCH_SGF to a list of SGF
+// files separated by ':' to run the same benchmarks on production inputs.
+
+#include "sgf_generators.hpp"
+#include "tabularpcn/utils/sgf_packed_loader.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <malloc.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+
+namespace {
+
+using ArenaLoader = SGFTreeLoader<SGFTreeNode, ArenaTree<SGFTreeNode>>;
+
+const std::map<std::string, std::string>& inputs()
+{
+    static const std::map<std::string, std::string> inputs = [] {
+        std::map<std::string, std::string> result;
+        SGFGenerator generator;
+        result["wide_or_root"] = generator.wideOrRoot(2000, 50);
+        result["deep_line"] = generator.deepLine(200000);
+        result["comment_heavy"] = generator.commentHeavy(50000, 2000);
+        result["transposition_heavy"] = generator.transpositionHeavy(9, 6);
+        result["mixed"] = generator.mixed(200000);
+        if (const char* paths = std::getenv("TABULARPCN_BENCH_SGF")) {
+            std::stringstream list(paths);
+            std::string path;
+            while (std::getline(list, path, ':')) {
+                std::ifstream file(path, std::ios::binary);
+                result["file:" + path] = std::string(std::istreambuf_iterator<char>(file), {});
+            }
+        }
+        return result;
+    }();
+    return inputs;
+}
+
+size_t countNodes(const std::string& sgf)
+{
+    static std::map<const std::string*, size_t> counts;
+    auto it = counts.find(&sgf);
+    if (it == counts.end()) {
+        it = counts.emplace(&sgf, ArenaLoader().loadFromString(sgf).getTreeSize()).first;
+    }
+    return it->second;
+}
+
+// heap bytes in use, including mmapped chunks; the resident set does not shrink when memory is freed
+size_t allocatedBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = ::mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+size_t peakResidentBytes()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+void BM_Lex(benchmark::State& state, const std::string* sgf)
+{
+    for (auto _ : state) {
+        MemoryInputStream input(sgf->data(), sgf->size());
+        SGFLexer lexer(input);
+        size_t tokens = 0;
+        while (lexer.nextToken().type != SGFTokenType::ENDOFFILE) { ++tokens; }
+        benchmark::DoNotOptimize(tokens);
+    }
+    state.SetBytesProcessed(state.iterations() * sgf->size());
+}
+
+void BM_Parse(benchmark::State& state, const std::string* sgf)
+{
+    TrackingNodeAllocator<SGFTreeNode> allocator;
+    for (auto _ : state) {
+        MemoryInputStream input(sgf->data(), sgf->size());
+        SGFParser parser(input, allocator);
+        while (parser.nextNode());
+        state.PauseTiming();
+        allocator.deallocateAll();
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * sgf->size());
+    state.SetItemsProcessed(state.iterations() * countNodes(*sgf));
+}
+
+template <typename TreeType>
+void BM_Load(benchmark::State& state, const std::string* sgf)
+{
+    SGFTreeLoader<SGFTreeNode, TreeType> loader;
+    for (auto _ : state) {
+        TreeType tree = loader.loadFromString(*sgf);
+        benchmark::DoNotOptimize(tree.getRootNode());
+        state.PauseTiming();
+        tree.reset();
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * sgf->size());
+    state.SetItemsProcessed(state.iterations() * countNodes(*sgf));
+}
+
+// repeated loads into recycled nodes, compare with load/tree and load/arena
+template <typename TreeType>
+void BM_LoadPooled(benchmark::State& state, const std::string* sgf)
+{
+    SGFTreeLoader<SGFTreeNode, TreeType> loader;
+    loader.setNodePool(std::make_shared<typename TreeType::node_pool_type>());
+    for (auto _ : state) {
+        TreeType tree = loader.loadFromString(*sgf);
+        benchmark::DoNotOptimize(tree.getRootNode());
+        state.PauseTiming();
+        tree.reset();
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * sgf->size());
+    state.SetItemsProcessed(state.iterations() * countNodes(*sgf));
+}
+
+// 16-byte nodes without virtual calls, compare with load/arena
+void BM_LoadPacked(benchmark::State& state, const std::string* sgf)
+{
+    SGFPackedLoader<> loader;
+    for (auto _ : state) {
+        PackedTree<SGFSolvePayload> tree = loader.loadFromString(*sgf);
+        benchmark::DoNotOptimize(tree.nodes_.data());
+    }
+    state.SetBytesProcessed(state.iterations() * sgf->size());
+    state.SetItemsProcessed(state.iterations() * countNodes(*sgf));
+}
+
+// progress reporting is meant to be left on, compare with load/arena
+void BM_LoadWithProgress(benchmark::State& state, const std::string* sgf)
+{
+    ArenaLoader loader;
+    size_t calls = 0;
+    loader.setProgressCallback([&calls](size_t, size_t) { ++calls; });
+    for (auto _ : state) {
+        ArenaTree<SGFTreeNode> tree = loader.loadFromString(*sgf);
+        benchmark::DoNotOptimize(tree.getRootNode());
+        state.PauseTiming();
+        tree.reset();
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * sgf->size());
+    state.SetItemsProcessed(state.iterations() * countNodes(*sgf));
+    state.counters["progress_calls"] = benchmark::Counter(static_cast<double>(calls), benchmark::Counter::kAvgIterations);
+}
+
+void BM_LoadParallel(benchmark::State& state, const std::string* sgf)
+{
+    ArenaLoader loader;
+    for (auto _ : state) {
+        ArenaTree<SGFTreeNode> tree = loader.loadParallelFromString(*sgf);
+        benchmark::DoNotOptimize(tree.getRootNode());
+        state.PauseTiming();
+        tree.reset();
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * sgf->size());
+    state.SetItemsProcessed(state.iterations() * countNodes(*sgf));
+}
+
+void BM_DfsTreeSize(benchmark::State& state, const std::string* sgf)
+{
+    ArenaLoader loader;
+    ArenaTree<SGFTreeNode> tree = loader.loadFromString(*sgf);
+    for (auto _ : state) {
+        ArenaLoader::dfsTreeSize(tree.getRootNode());
+        benchmark::DoNotOptimize(tree.getRootNode()->proof_tree_size_);
+    }
+    state.SetItemsProcessed(state.iterations() * tree.getTreeSize());
+}
+
+void BM_DfsTreeSizeArena(benchmark::State& state, const std::string* sgf)
+{
+    ArenaLoader loader;
+    ArenaTree<SGFTreeNode> tree = loader.loadFromString(*sgf);
+    for (auto _ : state) {
+        ArenaLoader::dfsTreeSize(tree);
+        benchmark::DoNotOptimize(tree.getRootNode()->proof_tree_size_);
+    }
+    state.SetItemsProcessed(state.iterations() * tree.getTreeSize());
+}
+
+void BM_DfsTreeSizeParallel(benchmark::State& state, const std::string* sgf)
+{
+    ArenaLoader loader;
+    ArenaTree<SGFTreeNode> tree = loader.loadFromString(*sgf);
+    for (auto _ : state) {
+        ArenaLoader::dfsTreeSizeParallel(tree);
+        benchmark::DoNotOptimize(tree.getRootNode()->proof_tree_size_);
+    }
+    state.SetItemsProcessed(state.iterations() * tree.getTreeSize());
+}
+
+void BM_TranspositionTreeSize(benchmark::State& state, const std::string* sgf)
+{
+    ArenaLoader loader;
+    ArenaTree<SGFTreeNode> tree = loader.loadFromString(*sgf);
+    for (auto _ : state) {
+        ArenaLoader::dfsTranspositionTreeSize(tree.getRootNode());
+        benchmark::DoNotOptimize(tree.getRootNode()->proof_tree_size_);
+    }
+    state.SetItemsProcessed(state.iterations() * tree.getTreeSize());
+}
+
+void BM_ToSgf(benchmark::State& state, const std::string* sgf)
+{
+    ArenaLoader loader;
+    ArenaTree<SGFTreeNode> tree = loader.loadFromString(*sgf);
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::string output = tree.getRootNode()->toSgf();
+        bytes += output.size();
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(state.iterations() * tree.getTreeSize());
+}
+
+// memory of a loaded tree, reported as counters rather than time
+template <typename TreeType>
+void BM_Memory(benchmark::State& state, const std::string* sgf, SGFPropertyPolicy::Mode mode)
+{
+    SGFTreeLoader<SGFTreeNode, TreeType> loader;
+    if (mode == SGFPropertyPolicy::Mode::NONE) {
+        loader.setPropertyPolicy(SGFPropertyPolicy::none());
+    } else if (mode == SGFPropertyPolicy::Mode::SOURCE) {
+        loader.setPropertyPolicy(SGFPropertyPolicy::source());
+    }
+    size_t nodes = 0, bytes = 0;
+    for (auto _ : state) {
+        size_t before = allocatedBytes();
+        TreeType tree = loader.loadFromString(*sgf);
+        bytes = allocatedBytes() - std::min(before, allocatedBytes());
+        nodes = tree.getTreeSize();
+        state.PauseTiming();
+        tree.reset();
+        state.ResumeTiming();
+    }
+    state.counters["nodes"] = static_cast<double>(nodes);
+    state.counters["bytes_per_node"] = nodes == 0 ? 0.0 : static_cast<double>(bytes) / nodes;
+    state.counters["peak_rss_bytes"] = static_cast<double>(peakResidentBytes());
+}
+
+void registerBenchmarks()
+{
+    for (const auto& [name, sgf] : inputs()) {
+        const std::string* input = &sgf;
+        benchmark::RegisterBenchmark(("lex/" + name).c_str(), BM_Lex, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("parse/" + name).c_str(), BM_Parse, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("load/tree/" + name).c_str(), BM_Load<Tree<SGFTreeNode>>, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("load/arena/" + name).c_str(), BM_Load<ArenaTree<SGFTreeNode>>, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("load/pooled/tree/" + name).c_str(), BM_LoadPooled<Tree<SGFTreeNode>>, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("load/pooled/arena/" + name).c_str(), BM_LoadPooled<ArenaTree<SGFTreeNode>>, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("load/packed/" + name).c_str(), BM_LoadPacked, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("load/progress/" + name).c_str(), BM_LoadWithProgress, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("load/parallel/" + name).c_str(), BM_LoadParallel, input)->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("dfs_tree_size/walk/" + name).c_str(), BM_DfsTreeSize, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("dfs_tree_size/arena/" + name).c_str(), BM_DfsTreeSizeArena, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("dfs_tree_size/parallel/" + name).c_str(), BM_DfsTreeSizeParallel, input)->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("dfs_tree_size/transpositions/" + name).c_str(), BM_TranspositionTreeSize, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("to_sgf/" + name).c_str(), BM_ToSgf, input)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("memory/all/" + name).c_str(), BM_Memory<ArenaTree<SGFTreeNode>>, input, SGFPropertyPolicy::Mode::ALL)->Unit(benchmark::kMillisecond)->Iterations(1);
+        benchmark::RegisterBenchmark(("memory/none/" + name).c_str(), BM_Memory<ArenaTree<SGFTreeNode>>, input, SGFPropertyPolicy::Mode::NONE)->Unit(benchmark::kMillisecond)->Iterations(1);
+        benchmark::RegisterBenchmark(("memory/source/" + name).c_str(), BM_Memory<ArenaTree<SGFTreeNode>>, input, SGFPropertyPolicy::Mode::SOURCE)->Unit(benchmark::kMillisecond)->Iterations(1);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    registerBenchmarks();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "tree.hpp"
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Structure-of-arrays copy of a tree with 32-bit indexes.
+ *
+ * Nodes are stored in preorder, so every subtree occupies the contiguous
+ * index range [i, i + tree_size_[i]) and children always come after their
+ * parent. Links that do not exist are NONE.
+ */
+class CompactTree {
+public:
+    using Index = uint32_t;
+    static constexpr Index NONE = std::numeric_limits<Index>::max();
+
+public:
+    CompactTree() = default;
+
+    /**
+     * @brief Build a compact copy of the subtree rooted at `root`.
+     *
+     * The type, solved flag and sizes are copied from the nodes, so the sizes
+     * must already be computed (or be recomputed on the compact tree). Sizes
+     * that do not fit in an Index throw std::length_error.
+     */
+    template <typename NodeType>
+    static CompactTree build(const NodeType* root)
+    {
+        return build(root, [](Index, const NodeType&) {});
+    }
+
+    /**
+     * @brief Same as build(root), also calling `visit(Index index, const NodeType& node)` for every node in preorder.
+     */
+    template <typename NodeType, typename Visitor>
+    static CompactTree build(const NodeType* root, Visitor&& visit)
+    {
+        return build(root, visit, true);
+    }
+
+    /**
+     * @brief Same as build(root, visit) without reading the sizes of the nodes, which are left 0.
+     *
+     * For trees whose sizes are recomputed on the compact tree, or ignored, so stale sizes cannot throw.
+     */
+    template <typename NodeType, typename Visitor>
+    static CompactTree buildStructure(const NodeType* root, Visitor&& visit)
+    {
+        return build(root, visit, false);
+    }
+
+    Index size() const { return static_cast<Index>(parent_.size()); }
+    bool empty() const { return parent_.empty(); }
+
+private:
+    template <typename NodeType, typename Visitor>
+    static CompactTree build(const NodeType* root, Visitor& visit, bool copy_sizes)
+    {
+        CompactTree tree;
+        if (root == nullptr) {
+            return tree;
+        }
+
+        // each entry is a node to visit, its parent and its previous sibling
+        struct Entry {
+            const BaseTreeNode* node;
+            Index parent;
+            Index prev_sibling;
+        };
+        std::vector<Entry> stack;
+        stack.push_back({root, NONE, NONE});
+        while (!stack.empty()) {
+            Entry entry = stack.back();
+            stack.pop_back();
+            while (entry.node != nullptr) {
+                if (tree.size() == NONE) {
+                    throw std::length_error("CompactTree supports at most " + std::to_string(NONE) + " nodes");
+                }
+                const NodeType* node = static_cast<const NodeType*>(entry.node);
+                Index index = tree.size();
+                tree.parent_.push_back(entry.parent);
+                tree.first_child_.push_back(NONE);
+                tree.next_sibling_.push_back(NONE);
+                tree.type_.push_back(node->type_);
+                tree.solved_.push_back(node->solved_);
+                tree.tree_size_.push_back(copy_sizes ? narrowSize(node->tree_size_) : 0);
+                tree.proof_tree_size_.push_back(copy_sizes ? narrowSize(node->proof_tree_size_) : 0);
+                tree.node_id_.push_back(node->id_);
+                visit(index, *node);
+                if (entry.prev_sibling != NONE) {
+                    tree.next_sibling_[entry.prev_sibling] = index;
+                } else if (entry.parent != NONE) {
+                    tree.first_child_[entry.parent] = index;
+                }
+
+                // visit the subtree first, then continue with the next sibling
+                if (entry.node != root && entry.node->next_sibling_ != nullptr) {
+                    stack.push_back({entry.node->next_sibling_, entry.parent, index});
+                }
+                entry = {entry.node->child_, index, NONE};
+            }
+        }
+        return tree;
+    }
+
+    template <typename Size>
+    static Index narrowSize(Size size)
+    {
+        if (size > std::numeric_limits<Index>::max()) {
+            throw std::length_error("CompactTree sizes must fit in 32 bits, got " + std::to_string(size));
+        }
+        return static_cast<Index>(size);
+    }
+
+public:
+    std::vector<Index> parent_;
+    std::vector<Index> first_child_;
+    std::vector<Index> next_sibling_;
+    std::vector<TreeNode::Type> type_;
+    std::vector<uint8_t> solved_;
+    std::vector<Index> tree_size_;
+    std::vector<Index> proof_tree_size_;
+    std::vector<size_t> node_id_; // id_ of the source node
+};
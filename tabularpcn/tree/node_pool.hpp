@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * @brief Slabs of nodes that are recycled in place across trees instead of going back to the heap.
+ *
+ * Every slot of a slab always holds a constructed node; released nodes are
+ * destroyed and default-constructed again in place. Slabs are only freed
+ * with the pool, so loading one tree after another stops allocating nodes.
+ * The heap memory of a node (e.g. the properties of an SGFTreeNode) is
+ * freed when it is recycled: pinning those buffers across loads scatters
+ * the next load's allocations around them and costs more than it saves.
+ *
+ * Nodes are handed out one at a time (acquire, for Tree and the parser
+ * allocators) or as whole slabs (acquireSlab, for ArenaTree).
+ *
+ * A pool is not thread-safe, use one per worker thread.
+ */
+template <typename NodeType, size_t SlabSize = 4096>
+class NodePool {
+public:
+    NodePool() = default;
+
+    // copy
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool()
+    {
+        for (NodeType* slab : slabs_) {
+            for (size_t i = 0; i < SlabSize; ++i) {
+                slab[i].~NodeType();
+            }
+            allocator_.deallocate(slab, SlabSize);
+        }
+    }
+
+    /**
+     * @brief A node in its default state.
+     */
+    NodeType* acquire()
+    {
+        if (!free_.empty()) {
+            NodeType* node = free_.back();
+            free_.pop_back();
+            return node;
+        }
+        if (used_ == SlabSize || node_slabs_.empty()) {
+            if (next_slab_ < node_slabs_.size()) {
+                ++next_slab_; // after releaseAll, refill the slabs handed out before
+            } else {
+                node_slabs_.push_back(acquireSlab());
+                next_slab_ = node_slabs_.size();
+            }
+            used_ = 0;
+        }
+        return node_slabs_[next_slab_ - 1] + used_++;
+    }
+
+    /**
+     * @brief Give back a node from acquire().
+     */
+    void release(NodeType* node)
+    {
+        recycle(node);
+        free_.push_back(node);
+    }
+
+    /**
+     * @brief Give back every node from acquire() at once, with one pass over their slabs.
+     */
+    void releaseAll()
+    {
+        for (size_t s = 0; s < next_slab_; ++s) {
+            size_t used = s + 1 == next_slab_ ? used_ : SlabSize;
+            for (size_t i = 0; i < used; ++i) {
+                recycle(node_slabs_[s] + i);
+            }
+        }
+        free_.clear();
+        next_slab_ = 0;
+        used_ = SlabSize;
+    }
+
+    /**
+     * @brief A slab of SlabSize nodes in their default state, owned by the caller until releaseSlab.
+     */
+    NodeType* acquireSlab()
+    {
+        if (!free_slabs_.empty()) {
+            NodeType* slab = free_slabs_.back();
+            free_slabs_.pop_back();
+            return slab;
+        }
+        NodeType* slab = allocator_.allocate(SlabSize);
+        size_t constructed = 0;
+        try {
+            for (; constructed < SlabSize; ++constructed) {
+                ::new (static_cast<void*>(slab + constructed)) NodeType();
+            }
+        } catch (...) {
+            for (size_t i = 0; i < constructed; ++i) {
+                slab[i].~NodeType();
+            }
+            allocator_.deallocate(slab, SlabSize);
+            throw;
+        }
+        slabs_.push_back(slab);
+        return slab;
+    }
+
+    /**
+     * @brief Give back a slab from acquireSlab(), of which the first `used` nodes may have been modified.
+     */
+    void releaseSlab(NodeType* slab, size_t used = SlabSize)
+    {
+        for (size_t i = 0; i < used; ++i) {
+            recycle(slab + i);
+        }
+        free_slabs_.push_back(slab);
+    }
+
+    /**
+     * @brief Bring a node back to its default state.
+     */
+    static void recycle(NodeType* node)
+    {
+        node->~NodeType();
+        ::new (static_cast<void*>(node)) NodeType();
+    }
+
+    size_t getSlabCount() const { return slabs_.size(); }
+
+private:
+    std::allocator<NodeType> allocator_;
+    std::vector<NodeType*> slabs_;      // every slab of the pool
+    std::vector<NodeType*> free_slabs_; // slabs not handed out
+    std::vector<NodeType*> node_slabs_; // slabs whose nodes are handed out one at a time
+    size_t next_slab_ = 0;              // node_slabs_[next_slab_ - 1] is being filled
+    size_t used_ = SlabSize;            // nodes handed out from that slab
+    std::vector<NodeType*> free_;       // released nodes of node_slabs_
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "compact_tree.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Node of a PackedTree: a user payload followed by 32-bit links and sizes, without a vtable.
+ *
+ * The payload provides the fields the size rules read, `type_` (TreeNode::Type)
+ * and `solved_`, and anything else a tool needs.
+ */
+template <typename Payload>
+struct PackedNode : Payload {
+    using Index = CompactTree::Index;
+
+    Index parent_ = CompactTree::NONE;
+    Index tree_size_ = 0;
+    Index proof_tree_size_ = 0;
+};
+
+/**
+ * @brief Tree of PackedNode values in one vector, in preorder.
+ *
+ * Children only store their parent: once the sizes are computed, the
+ * subtree of node i is [i, i + tree_size_), its first child is i + 1 and the
+ * next sibling of a child c is c + tree_size_ (while still inside the
+ * parent's subtree). Nodes must be created in preorder, see createNode.
+ */
+template <typename Payload>
+class PackedTree {
+public:
+    using Index = CompactTree::Index;
+    using NodeType = PackedNode<Payload>;
+    static constexpr Index NONE = CompactTree::NONE;
+
+public:
+    /**
+     * @brief Append a node below `parent` (NONE for the root), which must be the last node or one of its ancestors.
+     */
+    Index createNode(Index parent)
+    {
+        if (size() == NONE) {
+            throw std::length_error("PackedTree supports at most " + std::to_string(NONE) + " nodes");
+        }
+        nodes_.emplace_back();
+        nodes_.back().parent_ = parent;
+        return size() - 1;
+    }
+
+    /**
+     * @brief Compute tree_size_ and proof_tree_size_ of every node with the rules of SGFTreeLoader::dfsTreeSize.
+     *
+     * A single reverse sweep: every child comes after its parent, so it is final before it is added.
+     */
+    void computeSizes()
+    {
+        for (NodeType& node : nodes_) {
+            node.tree_size_ = 0;
+            node.proof_tree_size_ = 0;
+        }
+        for (Index i = size(); i-- > 0;) {
+            NodeType& node = nodes_[i];
+            node.tree_size_ += 1;
+            node.proof_tree_size_ = node.solved_ ? node.proof_tree_size_ + 1 : 0;
+            if (node.parent_ == NONE) {
+                continue;
+            }
+            // proof_tree_size_ of an OR node stays 0 until a solved child is seen, solved nodes are always >= 1
+            NodeType& parent = nodes_[node.parent_];
+            parent.tree_size_ += node.tree_size_;
+            if (!node.solved_) {
+                continue;
+            }
+            if (parent.type_ == TreeNode::Type::AND) { // sum for AND node
+                parent.proof_tree_size_ += node.proof_tree_size_;
+            } else if (parent.type_ == TreeNode::Type::OR) { // min for OR node
+                parent.proof_tree_size_ = parent.proof_tree_size_ == 0 ? node.proof_tree_size_ : std::min(parent.proof_tree_size_, node.proof_tree_size_);
+            }
+        }
+    }
+
+    Index firstChild(Index index) const
+    {
+        return nodes_[index].tree_size_ > 1 ? index + 1 : NONE;
+    }
+
+    Index nextSibling(Index index) const
+    {
+        Index parent = nodes_[index].parent_;
+        if (parent == NONE) {
+            return NONE;
+        }
+        Index next = index + nodes_[index].tree_size_;
+        return next < parent + nodes_[parent].tree_size_ ? next : NONE;
+    }
+
+    void clear() { nodes_.clear(); }
+    Index size() const { return static_cast<Index>(nodes_.size()); }
+    bool empty() const { return nodes_.empty(); }
+    NodeType& operator[](Index index) { return nodes_[index]; }
+    const NodeType& operator[](Index index) const { return nodes_[index]; }
+
+public:
+    std::vector<NodeType> nodes_;
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "compact_tree.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Extract the minimal proof tree of a solved tree.
+ *
+ * evaluate() recomputes tree_size_ and proof_tree_size_ of a CompactTree
+ * with the same rules as SGFTreeLoader::dfsTreeSize, recording for every
+ * solved OR node the solved child with the smallest proof (the first one on
+ * ties). The proof tree is then the root, all solved children of its AND
+ * nodes and the recorded child of its OR nodes, recursively; it has exactly
+ * proof_tree_size_ nodes.
+ *
+ * Subtrees of at most `parallel_threshold` nodes are evaluated as
+ * independent tasks, each a reverse sweep over its contiguous preorder
+ * range. The nodes above them are finished afterwards, children first.
+ */
+class ProofTreeExtractor {
+public:
+    using Index = CompactTree::Index;
+    static constexpr Index NONE = CompactTree::NONE;
+    static constexpr Index DEFAULT_PARALLEL_THRESHOLD = 1 << 16;
+
+    /**
+     * @param num_threads Number of threads evaluating subtrees, 0 for one per hardware thread.
+     * @param parallel_threshold Largest subtree evaluated by a single task.
+     */
+    explicit ProofTreeExtractor(size_t num_threads = 1, Index parallel_threshold = DEFAULT_PARALLEL_THRESHOLD)
+        : num_threads_(num_threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : num_threads), parallel_threshold_(std::max<Index>(1, parallel_threshold)) {}
+
+    /**
+     * @brief Compute the sizes of `tree` and the best child of every node, see bestChild.
+     */
+    void evaluate(CompactTree& tree)
+    {
+        Index size = tree.size();
+        std::fill(tree.tree_size_.begin(), tree.tree_size_.end(), 0);
+        std::fill(tree.proof_tree_size_.begin(), tree.proof_tree_size_.end(), 0);
+        best_child_.assign(size, NONE);
+        if (size == 0) {
+            return;
+        }
+        if (num_threads_ == 1 || size <= parallel_threshold_) {
+            sweep(tree, 0, size);
+            return;
+        }
+
+        // split top-down until the subtrees are small enough, the end of a subtree is where its next sibling (or its parent's end) starts
+        std::vector<std::pair<Index, Index>> tasks; // [begin, end) of a subtree
+        std::vector<Index> top;                     // nodes above the tasks, in preorder
+        std::vector<std::pair<Index, Index>> stack = {{0, size}};
+        while (!stack.empty()) {
+            auto [node, end] = stack.back();
+            stack.pop_back();
+            if (end - node <= parallel_threshold_) {
+                tasks.emplace_back(node, end);
+                continue;
+            }
+            top.push_back(node);
+            for (Index child = tree.first_child_[node]; child != NONE; child = tree.next_sibling_[child]) {
+                Index next = tree.next_sibling_[child];
+                stack.emplace_back(child, next == NONE ? end : next);
+            }
+        }
+
+        // largest subtrees first, so the threads finish at about the same time
+        std::sort(tasks.begin(), tasks.end(), [](const auto& a, const auto& b) { return a.second - a.first > b.second - b.first; });
+        std::vector<std::exception_ptr> errors(num_threads_);
+        std::atomic<size_t> next(0);
+        auto worker = [&](size_t thread_index) {
+            try {
+                for (size_t k = next++; k < tasks.size(); k = next++) {
+                    sweep(tree, tasks[k].first, tasks[k].second);
+                }
+            } catch (...) {
+                errors[thread_index] = std::current_exception();
+                next = tasks.size(); // stop the other workers
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < std::min(num_threads_, tasks.size()); ++t) {
+            threads.emplace_back(worker, t);
+        }
+        worker(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        // the children of a top node are tasks or later top nodes, so reverse preorder finishes them first
+        std::sort(top.begin(), top.end());
+        for (auto it = top.rbegin(); it != top.rend(); ++it) {
+            Index node = *it;
+            for (Index child = tree.first_child_[node]; child != NONE; child = tree.next_sibling_[child]) {
+                addChild(tree, node, child, false);
+            }
+            finish(tree, node);
+        }
+    }
+
+    /**
+     * @brief The solved child with the smallest proof of a solved OR node, NONE for other nodes.
+     */
+    Index bestChild(Index node) const
+    {
+        return best_child_[node];
+    }
+
+    /**
+     * @brief The minimal proof tree below `root` as indexes into the evaluated tree, in preorder.
+     *
+     * @return std::vector<Index> Empty if `root` is not solved.
+     */
+    std::vector<Index> extract(const CompactTree& tree, Index root = 0) const
+    {
+        std::vector<Index> proof;
+        if (root >= tree.size() || !tree.solved_[root]) {
+            return proof;
+        }
+        std::vector<Index> stack = {root};
+        std::vector<Index> children;
+        while (!stack.empty()) {
+            Index node = stack.back();
+            stack.pop_back();
+            proof.push_back(node);
+            if (tree.type_[node] == TreeNode::Type::AND) {
+                children.clear();
+                for (Index child = tree.first_child_[node]; child != NONE; child = tree.next_sibling_[child]) {
+                    if (tree.solved_[child]) {
+                        children.push_back(child);
+                    }
+                }
+                stack.insert(stack.end(), children.rbegin(), children.rend());
+            } else if (best_child_[node] != NONE) {
+                stack.push_back(best_child_[node]);
+            }
+        }
+        return proof;
+    }
+
+    /**
+     * @brief Evaluate the subtree of `root` and return the nodes of its minimal proof tree, in preorder.
+     *
+     * The nodes are not modified, their sizes need not be up to date.
+     */
+    template <typename NodeType>
+    std::vector<const NodeType*> extract(const NodeType* root)
+    {
+        std::vector<const NodeType*> nodes;
+        CompactTree tree = CompactTree::buildStructure(root, [&nodes](Index, const NodeType& node) { nodes.push_back(&node); });
+        evaluate(tree);
+        std::vector<const NodeType*> proof;
+        for (Index index : extract(tree)) {
+            proof.push_back(nodes[index]);
+        }
+        return proof;
+    }
+
+    /**
+     * @brief Copy the nodes of a proof tree (as returned by extract) into a new tree.
+     *
+     * The copies keep everything but their links, and their sizes are those
+     * of the proof tree. `source` owns the nodes; its resources (e.g. the
+     * input of SGFPropertyPolicy::source()) are shared with the new tree.
+     */
+    template <typename TreeType, typename NodeType>
+    static TreeType materialize(TreeType& source, const std::vector<const NodeType*>& proof)
+    {
+        TreeType tree;
+        for (const std::shared_ptr<const void>& resource : source.getResources()) {
+            tree.attach(resource);
+        }
+        std::unordered_map<const BaseTreeNode*, NodeType*> copies;
+        std::vector<NodeType*> order;
+        order.reserve(proof.size());
+        for (const NodeType* node : proof) {
+            NodeType* copy = tree.createNode(*node);
+            copy->parent_ = nullptr;
+            copy->child_ = nullptr;
+            copy->next_sibling_ = nullptr;
+            copy->last_child_ = nullptr;
+            copy->num_children_ = 0;
+            copy->tree_size_ = 0;
+            auto it = copies.find(node->parent_);
+            if (it != copies.end()) {
+                it->second->addChild(copy);
+            } else {
+                tree.setRootNode(copy);
+            }
+            copies.emplace(node, copy);
+            order.push_back(copy);
+        }
+        // every node of a proof tree is part of the proof
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            NodeType* copy = *it;
+            copy->tree_size_ += 1;
+            copy->proof_tree_size_ = copy->tree_size_;
+            if (copy->parent_ != nullptr) {
+                static_cast<NodeType*>(copy->parent_)->tree_size_ += copy->tree_size_;
+            }
+        }
+        return tree;
+    }
+
+private:
+    // a reverse sweep over the subtree [begin, end), every node is final before it is added to its parent
+    void sweep(CompactTree& tree, Index begin, Index end)
+    {
+        for (Index i = end; i-- > begin;) {
+            finish(tree, i);
+            if (i != begin) { // the parent of the subtree root is finished by the caller
+                addChild(tree, tree.parent_[i], i, true);
+            }
+        }
+    }
+
+    // proof_tree_size_ of an OR node stays 0 until a solved child is seen, solved nodes are always >= 1
+    void addChild(CompactTree& tree, Index parent, Index child, bool reverse)
+    {
+        tree.tree_size_[parent] += tree.tree_size_[child];
+        if (!tree.solved_[child]) {
+            return;
+        }
+        Index& proof_tree_size = tree.proof_tree_size_[parent];
+        if (tree.type_[parent] == TreeNode::Type::AND) { // sum for AND node
+            proof_tree_size += tree.proof_tree_size_[child];
+        } else if (tree.type_[parent] == TreeNode::Type::OR) { // min for OR node
+            // the first child in document order wins ties, the sweep sees the children last to first
+            Index child_size = tree.proof_tree_size_[child];
+            if (proof_tree_size == 0 || child_size < proof_tree_size || (reverse && child_size == proof_tree_size)) {
+                proof_tree_size = child_size;
+                best_child_[parent] = child;
+            }
+        }
+    }
+
+    void finish(CompactTree& tree, Index node)
+    {
+        tree.tree_size_[node] += 1;
+        if (tree.solved_[node]) {
+            tree.proof_tree_size_[node] += 1;
+        } else {
+            tree.proof_tree_size_[node] = 0;
+            best_child_[node] = NONE;
+        }
+    }
+
+    size_t num_threads_;
+    Index parallel_threshold_;
+    std::vector<Index> best_child_;
+};
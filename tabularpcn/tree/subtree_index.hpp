@@ -0,0 +1,171 @@
+#pragma once
+
+#include "compact_tree.hpp"
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Preorder numbering of a tree for subtree, ancestor and LCA queries.
+ *
+ * Nodes are numbered in preorder, so the subtree of node i is the
+ * contiguous range [i, subtreeEnd(i)) of nodes() and membership is two
+ * comparisons. Every node also has a jump pointer to an ancestor (the skew
+ * binary scheme of Myers), which finds the k-th ancestor and the lowest
+ * common ancestor in O(log n) steps with O(n) memory, unlike a full binary
+ * lifting table. The index is filled by SGFTreeLoader::dfsTreeSize in the
+ * same walk as the sizes and is stale once the tree structure changes.
+ */
+template <typename NodeType>
+class SubtreeIndex {
+public:
+    using Index = CompactTree::Index;
+    static constexpr Index NONE = CompactTree::NONE;
+
+    void clear()
+    {
+        nodes_.clear();
+        parent_.clear();
+        jump_.clear();
+        depth_.clear();
+        end_.clear();
+        postorder_.clear();
+        index_of_.clear();
+        num_finished_ = 0;
+    }
+
+    /**
+     * @brief Add a node in preorder, below the node `parent` (NONE for the root).
+     *
+     * @return Index The preorder number of the node.
+     */
+    Index enter(NodeType* node, Index parent)
+    {
+        if (nodes_.size() == NONE) {
+            throw std::length_error("SubtreeIndex supports at most " + std::to_string(NONE) + " nodes");
+        }
+        Index index = size();
+        Index jump = index;
+        if (parent != NONE) {
+            // jump twice as far as the parent if its jump and its jump's jump cover the same distance
+            Index parent_jump = jump_[parent];
+            jump = depth_[parent] - depth_[parent_jump] == depth_[parent_jump] - depth_[jump_[parent_jump]] ? jump_[parent_jump] : parent;
+        }
+        nodes_.push_back(node);
+        parent_.push_back(parent);
+        jump_.push_back(jump);
+        depth_.push_back(parent == NONE ? 0 : depth_[parent] + 1);
+        end_.push_back(NONE);
+        postorder_.push_back(NONE);
+        index_of_.emplace(node, index);
+        return index;
+    }
+
+    /**
+     * @brief Close a node once all of its descendants were entered, in postorder.
+     */
+    void leave(Index index)
+    {
+        end_[index] = size();
+        postorder_[index] = num_finished_++;
+    }
+
+    Index size() const { return static_cast<Index>(nodes_.size()); }
+    bool empty() const { return nodes_.empty(); }
+
+    /**
+     * @brief The nodes in preorder; the subtree of `index` is [index, subtreeEnd(index)).
+     */
+    const std::vector<NodeType*>& nodes() const { return nodes_; }
+    NodeType* node(Index index) const { return nodes_[index]; }
+
+    /**
+     * @brief The preorder number of a node, NONE if it was not indexed.
+     */
+    Index indexOf(const NodeType* node) const
+    {
+        auto it = index_of_.find(node);
+        return it == index_of_.end() ? NONE : it->second;
+    }
+
+    Index parent(Index index) const { return parent_[index]; }
+    Index depth(Index index) const { return depth_[index]; }
+    Index subtreeEnd(Index index) const { return end_[index]; }
+    Index postorder(Index index) const { return postorder_[index]; }
+
+    /**
+     * @brief Whether `descendant` is in the subtree of `ancestor`, a node is in its own subtree.
+     */
+    bool contains(Index ancestor, Index descendant) const
+    {
+        return ancestor <= descendant && descendant < end_[ancestor];
+    }
+
+    bool contains(const NodeType* ancestor, const NodeType* descendant) const
+    {
+        Index a = indexOf(ancestor);
+        Index d = indexOf(descendant);
+        return a != NONE && d != NONE && contains(a, d);
+    }
+
+    /**
+     * @brief The ancestor `k` levels above `index` (0 is the node itself), NONE above the root.
+     */
+    Index ancestor(Index index, size_t k) const
+    {
+        if (k > depth_[index]) {
+            return NONE;
+        }
+        Index target = depth_[index] - static_cast<Index>(k);
+        while (depth_[index] > target) {
+            index = depth_[jump_[index]] >= target ? jump_[index] : parent_[index];
+        }
+        return index;
+    }
+
+    /**
+     * @brief The lowest common ancestor of two nodes of the same tree.
+     */
+    Index lca(Index a, Index b) const
+    {
+        if (contains(a, b)) {
+            return a;
+        }
+        if (contains(b, a)) {
+            return b;
+        }
+        // climb from a to the deepest ancestor that contains b, skipping ancestors that do not
+        while (true) {
+            if (!contains(jump_[a], b)) {
+                a = jump_[a];
+            } else {
+                a = parent_[a];
+                if (contains(a, b)) {
+                    return a;
+                }
+            }
+        }
+    }
+
+    NodeType* lca(const NodeType* a, const NodeType* b) const
+    {
+        Index i = indexOf(a);
+        Index j = indexOf(b);
+        if (i == NONE || j == NONE) {
+            return nullptr;
+        }
+        return nodes_[lca(i, j)];
+    }
+
+private:
+    std::vector<NodeType*> nodes_;
+    std::vector<Index> parent_;
+    std::vector<Index> jump_;
+    std::vector<Index> depth_;
+    std::vector<Index> end_;
+    std::vector<Index> postorder_;
+    std::unordered_map<const NodeType*, Index> index_of_;
+    Index num_finished_ = 0;
+};
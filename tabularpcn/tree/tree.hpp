@@ -1,27 +1,33 @@
 #pragma once
 
+#include "node_pool.hpp"
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #pragma pack(push, 1)
 class BaseTreeNode {
 public:
     virtual ~BaseTreeNode() = default;
 
+    /**
+     * @brief Append a node to the children, detaching it from its previous parent first.
+     */
     virtual void addChild(BaseTreeNode* node)
     {
         node->detach();
         if (child_ == nullptr) {
             child_ = node;
         } else {
-            BaseTreeNode* current = child_;
-            while (current->next_sibling_ != nullptr) {
-                current = current->next_sibling_;
-            }
-            current->next_sibling_ = node;
+            last_child_->next_sibling_ = node;
         }
+        last_child_ = node;
         node->parent_ = this;
         ++num_children_;
     }
@@ -34,14 +40,18 @@ public:
     virtual BaseTreeNode* detach()
     {
         if (parent_ != nullptr) {
+            BaseTreeNode* prev = nullptr;
             if (parent_->child_ == this) {
                 parent_->child_ = next_sibling_;
             } else {
-                BaseTreeNode* ptr = parent_->child_;
-                while (ptr->next_sibling_ != this) {
-                    ptr = ptr->next_sibling_;
+                prev = parent_->child_;
+                while (prev->next_sibling_ != this) {
+                    prev = prev->next_sibling_;
                 }
-                ptr->next_sibling_ = next_sibling_;
+                prev->next_sibling_ = next_sibling_;
+            }
+            if (parent_->last_child_ == this) {
+                parent_->last_child_ = prev;
             }
             --parent_->num_children_;
             parent_ = nullptr;
@@ -54,6 +64,7 @@ public:
     BaseTreeNode* parent_ = nullptr;
     BaseTreeNode* child_ = nullptr;
     BaseTreeNode* next_sibling_ = nullptr;
+    BaseTreeNode* last_child_ = nullptr; // tail of the children list, so addChild does not walk it
     size_t num_children_ = 0;
 };
 
@@ -104,6 +115,7 @@ template <typename NodeType, typename Allocator = std::allocator<NodeType>>
 class Tree {
 public:
     using allocator_type = typename Allocator::template rebind<NodeType>::other;
+    using node_pool_type = NodePool<NodeType>;
 
 public:
     // copy
@@ -114,7 +126,9 @@ public:
     Tree(Tree&& other)
     {
         allocator_ = std::move(other.allocator_);
+        pool_ = std::move(other.pool_);
         nodes_ = std::move(other.nodes_);
+        resources_ = std::move(other.resources_);
         root_ = other.root_;
         other.root_ = nullptr;
     }
@@ -123,7 +137,9 @@ public:
         if (this != &other) {
             reset();
             allocator_ = std::move(other.allocator_);
+            pool_ = std::move(other.pool_);
             nodes_ = std::move(other.nodes_);
+            resources_ = std::move(other.resources_);
             root_ = other.root_;
             other.root_ = nullptr;
         }
@@ -142,15 +158,43 @@ public:
 
     void reset()
     {
-        while (!nodes_.empty()) {
-            deleteNode(*nodes_.begin());
+        for (NodeType* node : nodes_) {
+            freeNode(node);
         }
+        nodes_.clear();
+        resources_.clear(); // after the nodes, which may still refer to them
         root_ = nullptr;
     }
 
+    /**
+     * @brief Take the nodes from `pool` instead of the allocator, and give them back to it when deleted.
+     *
+     * The tree must be empty. A pool may be shared by several trees of the same thread.
+     */
+    void setNodePool(std::shared_ptr<node_pool_type> pool)
+    {
+        if (!nodes_.empty()) {
+            throw std::runtime_error("Cannot change the node pool of a non-empty tree");
+        }
+        pool_ = std::move(pool);
+    }
+
     template <typename... Args>
     NodeType* createNode(Args&&... args)
     {
+        if (pool_) {
+            NodeType* node = pool_->acquire();
+            try {
+                if constexpr (sizeof...(Args) > 0) {
+                    *node = NodeType(std::forward<Args>(args)...);
+                }
+                nodes_.insert(node);
+            } catch (...) {
+                pool_->release(node);
+                throw;
+            }
+            return node;
+        }
         NodeType* node = allocator_.allocate(1);
         try {
             allocator_.construct(node, std::forward<Args>(args)...);
@@ -162,11 +206,33 @@ public:
         return node;
     }
 
+    /**
+     * @brief Take over all nodes and resources of `other`, leaving it empty. The root is kept.
+     */
+    void adopt(Tree&& other)
+    {
+        if (pool_ != other.pool_) {
+            throw std::invalid_argument("Cannot adopt the nodes of a tree with another node pool");
+        }
+        nodes_.merge(other.nodes_);
+        resources_.insert(resources_.end(), other.resources_.begin(), other.resources_.end());
+        other.nodes_.clear();
+        other.resources_.clear();
+        other.root_ = nullptr;
+    }
+
     void deleteNode(NodeType* node)
     {
         nodes_.erase(node);
-        allocator_.destroy(node);
-        allocator_.deallocate(node, 1);
+        freeNode(node);
+    }
+
+    /**
+     * @brief Keep a resource the nodes refer to (e.g. the mapped source) alive until the tree is reset.
+     */
+    void attach(std::shared_ptr<const void> resource)
+    {
+        resources_.push_back(std::move(resource));
     }
 
     void setRootNode(NodeType* node)
@@ -177,9 +243,341 @@ public:
     std::unordered_set<NodeType*>& getNodes() { return nodes_; }
     NodeType* getRootNode() { return root_; }
     size_t getTreeSize() { return nodes_.size(); }
+    const std::vector<std::shared_ptr<const void>>& getResources() { return resources_; }
 
 protected:
+    void freeNode(NodeType* node)
+    {
+        if (pool_) {
+            pool_->release(node);
+        } else {
+            allocator_.destroy(node);
+            allocator_.deallocate(node, 1);
+        }
+    }
+
     allocator_type allocator_;
+    std::shared_ptr<node_pool_type> pool_;
     std::unordered_set<NodeType*> nodes_;
+    std::vector<std::shared_ptr<const void>> resources_;
     NodeType* root_;
 };
+
+
+/**
+ * @brief Tree whose nodes are stored contiguously in slabs of SlabSize nodes.
+ *
+ * Nodes are indexed by the slot they were created in, which is also written
+ * to `id_`, so NodeType must derive from TreeNode. Deleted nodes leave a hole
+ * that is not reused; all nodes are freed in bulk by reset().
+ *
+ * Several threads can create nodes at the same time through their own
+ * Cursor, each filling whole slabs of its own. The tree must not be used
+ * otherwise while cursors are alive.
+ *
+ * With a node pool (see setNodePool) the slabs are taken from and given
+ * back to the pool instead of the allocator.
+ */
+template <typename NodeType, typename Allocator = std::allocator<NodeType>, size_t SlabSize = 4096>
+class ArenaTree {
+public:
+    using allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<NodeType>;
+    using allocator_traits = std::allocator_traits<allocator_type>;
+    using node_pool_type = NodePool<NodeType, SlabSize>;
+
+    class Cursor {
+    public:
+        explicit Cursor(ArenaTree& tree) : tree_(tree) {}
+
+        // copy
+        Cursor(const Cursor&) = delete;
+        Cursor& operator=(const Cursor&) = delete;
+
+        ~Cursor()
+        {
+            release();
+        }
+
+        template <typename... Args>
+        NodeType* createNode(Args&&... args)
+        {
+            if (slab_ == nullptr || used_ == SlabSize) {
+                release();
+                slab_ = tree_.reserveSlab(slab_index_);
+            }
+            NodeType* node = slab_ + used_;
+            tree_.constructNode(node, std::forward<Args>(args)...);
+            node->id_ = slab_index_ * SlabSize + used_;
+            ++used_;
+            return node;
+        }
+
+        /**
+         * @brief Publish the nodes created so far to the tree.
+         */
+        void release()
+        {
+            if (slab_ != nullptr) {
+                tree_.commitSlab(slab_index_, used_);
+                slab_ = nullptr;
+                used_ = 0;
+            }
+        }
+
+    private:
+        ArenaTree& tree_;
+        NodeType* slab_ = nullptr;
+        size_t slab_index_ = 0;
+        size_t used_ = 0;
+    };
+
+public:
+    // copy
+    ArenaTree(const ArenaTree&) = delete;
+    ArenaTree& operator=(const ArenaTree&) = delete;
+
+    // move
+    ArenaTree(ArenaTree&& other)
+    {
+        moveFrom(other);
+    }
+    ArenaTree& operator=(ArenaTree&& other)
+    {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ArenaTree() = default;
+
+    ~ArenaTree()
+    {
+        reset(); // free memory
+    }
+
+    void reset()
+    {
+        for (size_t s = 0; s < slabs_.size(); ++s) {
+            NodeType* slab = slabs_[s];
+            if (pool_) {
+                pool_->releaseSlab(slab, slab_used_[s]); // deleted slots are recycled already
+                continue;
+            }
+            if constexpr (!std::is_trivially_destructible_v<NodeType>) {
+                for (size_t i = 0; i < slab_used_[s]; ++i) {
+                    if (!isDeleted(s * SlabSize + i)) {
+                        allocator_traits::destroy(allocator_, slab + i);
+                    }
+                }
+            }
+            allocator_traits::deallocate(allocator_, slab, SlabSize);
+        }
+        slabs_.clear();
+        slab_used_.clear();
+        deleted_.clear();
+        resources_.clear(); // after the nodes, which may still refer to them
+        current_slab_ = NO_SLAB;
+        num_nodes_ = 0;
+        root_ = nullptr;
+    }
+
+    /**
+     * @brief Take the slabs from `pool` instead of the allocator, and give them back to it on reset.
+     *
+     * The tree must be empty. A pool may be shared by several trees of the same thread.
+     */
+    void setNodePool(std::shared_ptr<node_pool_type> pool)
+    {
+        if (!slabs_.empty()) {
+            throw std::runtime_error("Cannot change the node pool of a non-empty tree");
+        }
+        pool_ = std::move(pool);
+    }
+
+    template <typename... Args>
+    NodeType* createNode(Args&&... args)
+    {
+        if (current_slab_ == NO_SLAB || slab_used_[current_slab_] == SlabSize) {
+            allocateSlab();
+            current_slab_ = slabs_.size() - 1;
+        }
+        size_t& used = slab_used_[current_slab_];
+        NodeType* node = slabs_[current_slab_] + used;
+        constructNode(node, std::forward<Args>(args)...);
+        node->id_ = current_slab_ * SlabSize + used;
+        ++used;
+        ++num_nodes_;
+        return node;
+    }
+
+    /**
+     * @brief Take over all slabs and resources of `other`, leaving it empty. The root is kept.
+     *
+     * The adopted nodes are renumbered after the existing slots, so they
+     * keep their relative order. `other` must not have live cursors.
+     */
+    void adopt(ArenaTree&& other)
+    {
+        if (pool_ != other.pool_) {
+            throw std::invalid_argument("Cannot adopt the nodes of a tree with another node pool");
+        }
+        size_t offset = getSlotCount();
+        other.forEachNode([offset](NodeType* node) { node->id_ += offset; });
+        if (!other.deleted_.empty()) {
+            deleted_.resize(offset, false);
+            deleted_.insert(deleted_.end(), other.deleted_.begin(), other.deleted_.end());
+        }
+        slabs_.insert(slabs_.end(), other.slabs_.begin(), other.slabs_.end());
+        slab_used_.insert(slab_used_.end(), other.slab_used_.begin(), other.slab_used_.end());
+        resources_.insert(resources_.end(), other.resources_.begin(), other.resources_.end());
+        num_nodes_ += other.num_nodes_;
+        other.slabs_.clear();
+        other.slab_used_.clear();
+        other.deleted_.clear();
+        other.resources_.clear();
+        other.current_slab_ = NO_SLAB;
+        other.num_nodes_ = 0;
+        other.root_ = nullptr;
+    }
+
+    void deleteNode(NodeType* node)
+    {
+        size_t id = node->id_;
+        if (pool_) {
+            node_pool_type::recycle(node); // pooled slots always hold a node
+        } else {
+            allocator_traits::destroy(allocator_, node);
+        }
+        if (deleted_.size() < getSlotCount()) {
+            deleted_.resize(getSlotCount(), false);
+        }
+        deleted_[id] = true;
+        --num_nodes_;
+    }
+
+    /**
+     * @brief Get the node created with the given id, or nullptr if there is none.
+     */
+    NodeType* getNode(size_t id)
+    {
+        size_t s = id / SlabSize;
+        if (s >= slabs_.size() || id % SlabSize >= slab_used_[s] || isDeleted(id)) {
+            return nullptr;
+        }
+        return slabs_[s] + id % SlabSize;
+    }
+
+    /**
+     * @brief Call `func(NodeType*)` on every node in id order.
+     */
+    template <typename Func>
+    void forEachNode(Func&& func)
+    {
+        for (size_t s = 0; s < slabs_.size(); ++s) {
+            for (size_t i = 0; i < slab_used_[s]; ++i) {
+                if (!isDeleted(s * SlabSize + i)) {
+                    func(slabs_[s] + i);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Keep a resource the nodes refer to (e.g. the mapped source) alive until the tree is reset.
+     */
+    void attach(std::shared_ptr<const void> resource)
+    {
+        resources_.push_back(std::move(resource));
+    }
+
+    void setRootNode(NodeType* node)
+    {
+        root_ = node;
+    }
+
+    NodeType* getRootNode() { return root_; }
+    size_t getTreeSize() { return num_nodes_; }
+    size_t getSlotCount() { return slabs_.size() * SlabSize; } // all ids are below this
+    const std::vector<std::shared_ptr<const void>>& getResources() { return resources_; }
+
+protected:
+    static constexpr size_t NO_SLAB = static_cast<size_t>(-1);
+
+    bool isDeleted(size_t id) const
+    {
+        return id < deleted_.size() && deleted_[id];
+    }
+
+    void allocateSlab()
+    {
+        slabs_.push_back(pool_ ? pool_->acquireSlab() : allocator_traits::allocate(allocator_, SlabSize));
+        slab_used_.push_back(0);
+    }
+
+    // a pooled slot holds a recycled node already
+    template <typename... Args>
+    void constructNode(NodeType* node, Args&&... args)
+    {
+        if (!pool_) {
+            allocator_traits::construct(allocator_, node, std::forward<Args>(args)...);
+        } else if constexpr (sizeof...(Args) > 0) {
+            *node = NodeType(std::forward<Args>(args)...);
+        }
+    }
+
+    NodeType* reserveSlab(size_t& slab_index)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        allocateSlab();
+        slab_index = slabs_.size() - 1;
+        return slabs_.back();
+    }
+
+    void commitSlab(size_t slab_index, size_t used)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slab_used_[slab_index] = used;
+        num_nodes_ += used;
+    }
+
+    void moveFrom(ArenaTree& other)
+    {
+        allocator_ = std::move(other.allocator_);
+        pool_ = std::move(other.pool_);
+        slabs_ = std::move(other.slabs_);
+        slab_used_ = std::move(other.slab_used_);
+        deleted_ = std::move(other.deleted_);
+        resources_ = std::move(other.resources_);
+        current_slab_ = other.current_slab_;
+        num_nodes_ = other.num_nodes_;
+        root_ = other.root_;
+        other.slabs_.clear();
+        other.slab_used_.clear();
+        other.deleted_.clear();
+        other.resources_.clear();
+        other.current_slab_ = NO_SLAB;
+        other.num_nodes_ = 0;
+        other.root_ = nullptr;
+    }
+
+    allocator_type allocator_;
+    std::shared_ptr<node_pool_type> pool_;
+    std::vector<NodeType*> slabs_;
+    std::vector<size_t> slab_used_; // number of constructed slots in each slab
+    std::vector<bool> deleted_;
+    std::vector<std::shared_ptr<const void>> resources_;
+    size_t current_slab_ = NO_SLAB; // slab filled by createNode
+    size_t num_nodes_ = 0;
+    NodeType* root_ = nullptr;
+    std::mutex mutex_;
+};
+
+/**
+ * @brief Whether a tree type indexes its nodes by id_ (e.g. ArenaTree), so ids must not be reassigned.
+ */
+template <typename T, typename = void>
+struct IsIndexedTree : std::false_type {};
+template <typename T>
+struct IsIndexedTree<T, std::void_t<decltype(std::declval<T&>().getNode(size_t()))>> : std::true_type {};
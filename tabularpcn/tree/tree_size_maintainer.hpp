@@ -0,0 +1,169 @@
+#pragma once
+
+#include "tree.hpp"
+#include <unordered_map>
+
+/**
+ * @brief Keep tree_size_ and proof_tree_size_ up to date while subtrees are grafted and pruned.
+ *
+ * The sizes follow the same rules as SGFTreeLoader::dfsTreeSize and must be
+ * correct before the first edit. An edit only walks the ancestors of the
+ * changed node, applying the difference of its contribution: AND nodes add
+ * it to their sum, OR nodes update their minimum. For the minimum, the
+ * number of solved children that reach it is counted the first time an OR
+ * node is touched; the children are only scanned again when the last of
+ * them goes away. Edits of the structure or the solved flags that do not
+ * go through the maintainer invalidate these counts, call clear() then.
+ */
+template <typename NodeType>
+class TreeSizeMaintainer {
+public:
+    /**
+     * @brief Append `subtree`, whose sizes are computed, to the children of `parent`.
+     */
+    void graft(NodeType* parent, NodeType* subtree)
+    {
+        if (subtree->parent_ != nullptr) {
+            prune(subtree);
+        }
+        parent->addChild(subtree);
+        propagate(parent, Contribution(), contribution(subtree));
+    }
+
+    /**
+     * @brief Detach `subtree` from its parent.
+     */
+    void prune(NodeType* subtree)
+    {
+        NodeType* parent = static_cast<NodeType*>(subtree->parent_);
+        if (parent == nullptr) {
+            return;
+        }
+        Contribution removed = contribution(subtree);
+        subtree->detach();
+        propagate(parent, removed, Contribution());
+    }
+
+    /**
+     * @brief Recompute a node from its children, e.g. after its solved_ or type_ changed.
+     */
+    void refresh(NodeType* node)
+    {
+        // solved_ may already have changed, the sizes have not: solved nodes have a proof of at least one node
+        Contribution before = {node->tree_size_, node->proof_tree_size_, node->proof_tree_size_ != 0};
+        min_counts_.erase(node);
+        node->tree_size_ = 1;
+        node->proof_tree_size_ = 0;
+        for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+            node->tree_size_ += static_cast<NodeType*>(child)->tree_size_;
+        }
+        if (node->solved_) {
+            node->proof_tree_size_ = 1;
+            if (node->type_ == NodeType::Type::AND) {
+                for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+                    Contribution c = contribution(static_cast<NodeType*>(child));
+                    node->proof_tree_size_ += c.solved ? c.proof_tree_size : 0;
+                }
+            } else if (node->type_ == NodeType::Type::OR) {
+                node->proof_tree_size_ += scanMin(node).min;
+            }
+        }
+        if (node->parent_ != nullptr) {
+            propagate(static_cast<NodeType*>(node->parent_), before, contribution(node));
+        }
+    }
+
+    /**
+     * @brief Forget the OR bookkeeping, e.g. after nodes were deleted or edited directly.
+     */
+    void clear()
+    {
+        min_counts_.clear();
+    }
+
+private:
+    // what a child adds to its parent
+    struct Contribution {
+        size_t tree_size = 0;
+        size_t proof_tree_size = 0;
+        bool solved = false;
+
+        bool operator==(const Contribution& other) const
+        {
+            return tree_size == other.tree_size && proof_tree_size == other.proof_tree_size && solved == other.solved;
+        }
+    };
+
+    // smallest proof_tree_size_ of the solved children (0 if there is none) and how many reach it
+    struct MinCount {
+        size_t min = 0;
+        size_t count = 0;
+    };
+
+    static Contribution contribution(const NodeType* node)
+    {
+        return {node->tree_size_, node->proof_tree_size_, node->solved_};
+    }
+
+    void propagate(NodeType* node, Contribution removed, Contribution added)
+    {
+        while (node != nullptr) {
+            Contribution before = contribution(node);
+            node->tree_size_ = node->tree_size_ - removed.tree_size + added.tree_size;
+            if (node->solved_) {
+                if (node->type_ == NodeType::Type::AND) { // sum for AND node
+                    node->proof_tree_size_ = node->proof_tree_size_ - (removed.solved ? removed.proof_tree_size : 0) + (added.solved ? added.proof_tree_size : 0);
+                } else if (node->type_ == NodeType::Type::OR) { // min for OR node
+                    node->proof_tree_size_ = updateMin(node, removed, added) + 1;
+                }
+            }
+            Contribution after = contribution(node);
+            if (after == before) {
+                return;
+            }
+            removed = before;
+            added = after;
+            node = static_cast<NodeType*>(node->parent_);
+        }
+    }
+
+    // the children already reflect the edit, `removed` and `added` describe it
+    size_t updateMin(NodeType* node, const Contribution& removed, const Contribution& added)
+    {
+        auto it = min_counts_.find(node);
+        if (it == min_counts_.end() || it->second.min != node->proof_tree_size_ - 1) {
+            return (min_counts_[node] = scanMin(node)).min;
+        }
+        MinCount& min_count = it->second;
+        if (removed.solved && removed.proof_tree_size == min_count.min && --min_count.count == 0) {
+            return (min_count = scanMin(node)).min; // the last child at the minimum is gone
+        }
+        if (added.solved) {
+            if (min_count.min == 0 || added.proof_tree_size < min_count.min) {
+                min_count = {added.proof_tree_size, 1};
+            } else if (added.proof_tree_size == min_count.min) {
+                ++min_count.count;
+            }
+        }
+        return min_count.min;
+    }
+
+    static MinCount scanMin(const NodeType* node)
+    {
+        MinCount min_count;
+        for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+            const NodeType* child_node = static_cast<const NodeType*>(child);
+            if (!child_node->solved_) {
+                continue;
+            }
+            if (min_count.min == 0 || child_node->proof_tree_size_ < min_count.min) {
+                min_count = {child_node->proof_tree_size_, 1};
+            } else if (child_node->proof_tree_size_ == min_count.min) {
+                ++min_count.count;
+            }
+        }
+        return min_count;
+    }
+
+    std::unordered_map<const BaseTreeNode*, MinCount> min_counts_;
+};
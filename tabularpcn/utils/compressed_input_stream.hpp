@@ -0,0 +1,390 @@
+#pragma once
+
+#include "sgf_lexer.hpp"
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Decompression needs the library headers and linking against it, so each codec is opt-in:
+// define TABULARPCN_USE_ZLIB (link -lz) and/or TABULARPCN_USE_ZSTD (link -lzstd).
+#if defined(TABULARPCN_USE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(TABULARPCN_USE_ZSTD)
+#include <zstd.h>
+#endif
+
+enum class Compression {
+    NONE,
+    GZIP,
+    ZSTD,
+};
+
+/**
+ * @brief Input stream that decompresses a file in large blocks on a background thread.
+ *
+ * While the lexer consumes one block, the next ones are decompressed, so
+ * decompression overlaps with parsing. The format is detected from the
+ * magic bytes; uncompressed files are read in blocks as well.
+ */
+class CompressedFileInputStream : public BaseInputStream {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 4 << 20;
+    static constexpr size_t NUM_BLOCKS = 3; // one being read, the others being filled
+
+public:
+    explicit CompressedFileInputStream(const std::string& filename, size_t block_size = DEFAULT_BLOCK_SIZE)
+        : decoder_(openDecoder(filename)), block_size_(block_size)
+    {
+        blocks_.resize(NUM_BLOCKS);
+        for (Block& block : blocks_) {
+            block.data.resize(block_size_ + 1); // data[0] keeps the last byte of the previous block for unget()
+            free_.push_back(&block);
+        }
+        producer_ = std::thread([this]() { produce(); });
+    }
+
+    // copy
+    CompressedFileInputStream(const CompressedFileInputStream&) = delete;
+    CompressedFileInputStream& operator=(const CompressedFileInputStream&) = delete;
+
+    ~CompressedFileInputStream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        free_cv_.notify_all();
+        producer_.join();
+    }
+
+    char peek() final
+    {
+        if (index_ == end_ && !nextBlock()) {
+            return '\0';
+        }
+        return current_->data[index_];
+    }
+
+    char get() final
+    {
+        if (index_ == end_ && !nextBlock()) {
+            return '\0';
+        }
+        return current_->data[index_++];
+    }
+
+    void unget() final
+    {
+        if (index_ > 0 && block_offset_ + index_ > 1) {
+            --index_;
+        }
+    }
+
+    size_t tellg() final
+    {
+        return block_offset_ + index_ - 1;
+    }
+
+    /**
+     * @brief Detect the compression of a file from its magic bytes.
+     */
+    static Compression detect(const std::string& filename)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::invalid_argument("Cannot open file: " + filename);
+        }
+        unsigned char magic[4] = {};
+        ssize_t n = ::read(fd, magic, sizeof(magic));
+        ::close(fd);
+        if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+            return Compression::GZIP;
+        }
+        if (n >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+            return Compression::ZSTD;
+        }
+        return Compression::NONE;
+    }
+
+    /**
+     * @brief Decompress a whole file into a string.
+     */
+    static std::string readAll(const std::string& filename)
+    {
+        std::unique_ptr<Decoder> decoder = openDecoder(filename);
+        std::string result;
+        size_t size = 0;
+        while (true) {
+            result.resize(size + DEFAULT_BLOCK_SIZE);
+            size_t n = decoder->read(&result[size], DEFAULT_BLOCK_SIZE);
+            if (n == 0) {
+                break;
+            }
+            size += n;
+        }
+        result.resize(size);
+        return result;
+    }
+
+private:
+    // reads decompressed bytes, 0 at the end of the input
+    class Decoder {
+    public:
+        explicit Decoder(const std::string& filename) : fd_(::open(filename.c_str(), O_RDONLY))
+        {
+            if (fd_ < 0) {
+                throw std::invalid_argument("Cannot open file: " + filename);
+            }
+        }
+
+        virtual ~Decoder() { ::close(fd_); }
+        virtual size_t read(char* out, size_t capacity) = 0;
+
+    protected:
+        size_t readRaw(char* out, size_t capacity)
+        {
+            while (true) {
+                ssize_t n = ::read(fd_, out, capacity);
+                if (n >= 0) {
+                    return static_cast<size_t>(n);
+                }
+                if (errno != EINTR) {
+                    throw std::runtime_error(std::string("Cannot read file: ") + std::strerror(errno));
+                }
+            }
+        }
+
+        int fd_;
+    };
+
+    class RawDecoder : public Decoder {
+    public:
+        using Decoder::Decoder;
+
+        size_t read(char* out, size_t capacity) override
+        {
+            size_t total = 0;
+            while (total < capacity) {
+                size_t n = readRaw(out + total, capacity - total);
+                if (n == 0) {
+                    break;
+                }
+                total += n;
+            }
+            return total;
+        }
+    };
+
+#if defined(TABULARPCN_USE_ZLIB)
+    class GzipDecoder : public Decoder {
+    public:
+        explicit GzipDecoder(const std::string& filename) : Decoder(filename), input_(1 << 16)
+        {
+            std::memset(&stream_, 0, sizeof(stream_));
+            if (inflateInit2(&stream_, 15 + 32) != Z_OK) { // 32: detect the gzip header
+                throw std::runtime_error("Cannot initialize zlib");
+            }
+        }
+
+        ~GzipDecoder() override { inflateEnd(&stream_); }
+
+        size_t read(char* out, size_t capacity) override
+        {
+            stream_.next_out = reinterpret_cast<Bytef*>(out);
+            stream_.avail_out = static_cast<uInt>(capacity);
+            while (stream_.avail_out > 0) {
+                if (stream_.avail_in == 0) {
+                    stream_.avail_in = static_cast<uInt>(readRaw(input_.data(), input_.size()));
+                    stream_.next_in = reinterpret_cast<Bytef*>(input_.data());
+                    if (stream_.avail_in == 0) {
+                        if (!finished_ && stream_.avail_out == capacity) { // hand out what was decoded before the error
+                            throw SGFTruncatedError("Truncated gzip input");
+                        }
+                        break;
+                    }
+                }
+                int ret = inflate(&stream_, Z_NO_FLUSH);
+                finished_ = ret == Z_STREAM_END;
+                if (ret == Z_STREAM_END) {
+                    inflateReset(&stream_); // concatenated members
+                } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                    throw std::runtime_error(std::string("Invalid gzip input: ") + (stream_.msg ? stream_.msg : "unknown error"));
+                }
+            }
+            return capacity - stream_.avail_out;
+        }
+
+    private:
+        z_stream stream_;
+        std::vector<char> input_;
+        bool finished_ = false; // at a member boundary
+    };
+#endif
+
+#if defined(TABULARPCN_USE_ZSTD)
+    class ZstdDecoder : public Decoder {
+    public:
+        explicit ZstdDecoder(const std::string& filename) : Decoder(filename), input_(ZSTD_DStreamInSize()), stream_(ZSTD_createDStream())
+        {
+            if (stream_ == nullptr) {
+                throw std::runtime_error("Cannot initialize zstd");
+            }
+        }
+
+        ~ZstdDecoder() override { ZSTD_freeDStream(stream_); }
+
+        size_t read(char* out, size_t capacity) override
+        {
+            ZSTD_outBuffer output = {out, capacity, 0};
+            while (output.pos < output.size) {
+                if (in_.pos == in_.size) {
+                    in_ = {input_.data(), readRaw(input_.data(), input_.size()), 0};
+                    if (in_.size == 0) {
+                        if (!finished_ && output.pos == 0) { // hand out what was decoded before the error
+                            throw SGFTruncatedError("Truncated zstd input");
+                        }
+                        break;
+                    }
+                }
+                size_t ret = ZSTD_decompressStream(stream_, &output, &in_);
+                if (ZSTD_isError(ret)) {
+                    throw std::runtime_error(std::string("Invalid zstd input: ") + ZSTD_getErrorName(ret));
+                }
+                finished_ = ret == 0; // at a frame boundary
+            }
+            return output.pos;
+        }
+
+    private:
+        std::vector<char> input_;
+        ZSTD_DStream* stream_;
+        ZSTD_inBuffer in_ = {nullptr, 0, 0};
+        bool finished_ = true;
+    };
+#endif
+
+    static std::unique_ptr<Decoder> openDecoder(const std::string& filename)
+    {
+        switch (detect(filename)) {
+            case Compression::GZIP:
+#if defined(TABULARPCN_USE_ZLIB)
+                return std::make_unique<GzipDecoder>(filename);
+#else
+                throw std::runtime_error("gzip input needs TABULARPCN_USE_ZLIB: " + filename);
+#endif
+            case Compression::ZSTD:
+#if defined(TABULARPCN_USE_ZSTD)
+                return std::make_unique<ZstdDecoder>(filename);
+#else
+                throw std::runtime_error("zstd input needs TABULARPCN_USE_ZSTD: " + filename);
+#endif
+            default:
+                return std::make_unique<RawDecoder>(filename);
+        }
+    }
+
+    struct Block {
+        std::vector<char> data;
+        size_t size = 0; // decompressed bytes after data[0], 0 for the end of the input
+    };
+
+    void produce()
+    {
+        while (true) {
+            Block* block;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                free_cv_.wait(lock, [this]() { return stop_ || !free_.empty(); });
+                if (stop_) {
+                    return;
+                }
+                block = free_.front();
+                free_.pop_front();
+            }
+            std::exception_ptr error;
+            try {
+                block->size = decoder_->read(block->data.data() + 1, block_size_);
+            } catch (...) {
+                error = std::current_exception();
+                block->size = 0;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_ = error;
+                ready_.push_back(block);
+            }
+            ready_cv_.notify_one();
+            if (block->size == 0) {
+                return;
+            }
+        }
+    }
+
+    // switch to the next decompressed block, false at the end of the input
+    bool nextBlock()
+    {
+        if (done_) {
+            return false;
+        }
+        Block* block;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_cv_.wait(lock, [this]() { return !ready_.empty(); });
+            block = ready_.front();
+            ready_.pop_front();
+            if (block->size == 0 && error_) { // the blocks decoded before the error come first
+                done_ = true;
+                std::rethrow_exception(error_);
+            }
+        }
+        if (block->size == 0) {
+            done_ = true;
+            return false;
+        }
+        // keep the last byte so that unget() works across the block boundary
+        block->data[0] = current_ != nullptr ? current_->data[end_ - 1] : '\0';
+        block_offset_ += end_ - 1;
+        if (current_ != nullptr) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                free_.push_back(current_);
+            }
+            free_cv_.notify_one();
+        } else {
+            block_offset_ = 0;
+        }
+        current_ = block;
+        index_ = 1;
+        end_ = block->size + 1;
+        return true;
+    }
+
+    std::unique_ptr<Decoder> decoder_;
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    Block* current_ = nullptr;
+    size_t index_ = 1; // position in current_->data
+    size_t end_ = 1;
+    size_t block_offset_ = 0; // position of current_->data[1] in the input
+    bool done_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable free_cv_;
+    std::condition_variable ready_cv_;
+    std::deque<Block*> free_;
+    std::deque<Block*> ready_;
+    std::exception_ptr error_;
+    bool stop_ = false;
+    std::thread producer_;
+};
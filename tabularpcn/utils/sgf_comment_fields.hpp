@@ -0,0 +1,103 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Extractor of the "key value" lines that solvers write into comments.
+ *
+ * Every registered key is matched anywhere in the comment, like
+ * std::string::find, and its handler receives the text from the end of the
+ * key to the end of the line, without the '\r' of a "\r\n". Only the first
+ * occurrence of a key is used, and handlers run in registration order. The
+ * comment is scanned once for all keys: a table of key first bytes selects
+ * the candidate keys to compare at each byte, and nothing is allocated.
+ *
+ * Register fields before loading; the registry is not synchronized.
+ */
+template <typename NodeType>
+class SGFCommentFields {
+public:
+    using Handler = std::function<void(NodeType& node, std::string_view value)>;
+
+    static constexpr size_t MAX_FIELDS = 64; // one bit per field in the scan
+
+public:
+    /**
+     * @brief Register a key (including its separator, e.g. "match_tt = ").
+     */
+    void add(std::string key, Handler handler)
+    {
+        if (key.empty()) {
+            throw std::invalid_argument("Comment field key cannot be empty");
+        }
+        if (fields_.size() == MAX_FIELDS) {
+            throw std::invalid_argument("Too many comment fields, at most " + std::to_string(MAX_FIELDS));
+        }
+        first_byte_fields_[static_cast<unsigned char>(key[0])] |= uint64_t(1) << fields_.size();
+        fields_.push_back({std::move(key), std::move(handler)});
+    }
+
+    /**
+     * @brief Register a key whose value is parsed into an integer member of the node.
+     *
+     * Values that are not a number leave the member unchanged.
+     */
+    template <typename Integer>
+    void addInteger(std::string key, Integer NodeType::*member)
+    {
+        add(std::move(key), [member](NodeType& node, std::string_view value) {
+            Integer parsed;
+            if (std::from_chars(value.data(), value.data() + value.size(), parsed).ec == std::errc()) {
+                node.*member = parsed;
+            }
+        });
+    }
+
+    void extract(NodeType& node, std::string_view comment) const
+    {
+        // first occurrence of every key, left to right
+        size_t positions[MAX_FIELDS];
+        uint64_t found = 0;
+        uint64_t missing = fields_.size() == MAX_FIELDS ? ~uint64_t(0) : (uint64_t(1) << fields_.size()) - 1;
+        for (size_t pos = 0; pos < comment.size() && missing != 0; ++pos) {
+            uint64_t candidates = first_byte_fields_[static_cast<unsigned char>(comment[pos])] & missing;
+            while (candidates != 0) {
+                size_t k = __builtin_ctzll(candidates);
+                candidates &= candidates - 1;
+                if (comment.compare(pos, fields_[k].key.size(), fields_[k].key) == 0) {
+                    positions[k] = pos;
+                    found |= uint64_t(1) << k;
+                    missing &= ~(uint64_t(1) << k);
+                }
+            }
+        }
+
+        for (; found != 0; found &= found - 1) {
+            size_t k = __builtin_ctzll(found);
+            const Field& field = fields_[k];
+            std::string_view value = comment.substr(positions[k] + field.key.size());
+            size_t line_end = value.find('\n');
+            if (line_end != std::string_view::npos) {
+                value = value.substr(0, line_end != 0 && value[line_end - 1] == '\r' ? line_end - 1 : line_end);
+            }
+            field.handler(node, value);
+        }
+    }
+
+    size_t size() const { return fields_.size(); }
+
+private:
+    struct Field {
+        std::string key;
+        Handler handler;
+    };
+
+    std::vector<Field> fields_;
+    uint64_t first_byte_fields_[256] = {}; // bit k is set when the key of field k starts with the byte
+};
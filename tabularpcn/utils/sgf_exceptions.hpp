@@ -1,33 +1,73 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 
+/**
+ * @brief Error at a [start, end) range of the input, npos when the stream could not tell its position.
+ */
 class BaseSGFException : public std::runtime_error {
 public:
-    BaseSGFException(const std::string& message, int start, int end, bool detail = false, const std::string& sgf = "", int offset = 20, const std::string& highlight_start = "\033[1;31m", const std::string& highlight_end = "\033[0m")
+    static constexpr size_t npos = static_cast<size_t>(-1); // e.g. the position of a std::ifstream at its end
+
+    BaseSGFException(const std::string& message, size_t start, size_t end, bool detail = false, const std::string& sgf = "", size_t offset = 20, const std::string& highlight_start = "\033[1;31m", const std::string& highlight_end = "\033[0m")
         : std::runtime_error([&]() {
-              if (!detail) {
+              if (start == npos || end == npos) {
+                  return message;
+              }
+              if (!detail || sgf.empty() || end > sgf.length() || start > end) {
                   return message + " at " + std::to_string(start) + ":" + std::to_string(end);
-              } else {
-                  if (sgf.empty()) {
-                      return message + " at " + std::to_string(start) + ":" + std::to_string(end);
-                  }
-                  int s = std::max(0, start - offset);
-                  int e = std::min(static_cast<int>(sgf.length()), end + offset);
-                  return message + " at " + std::to_string(start) + ":" + std::to_string(end) + "\n" + sgf.substr(s, start - s) + highlight_start + sgf.substr(start, end - start) + highlight_end + sgf.substr(end, e - end);
               }
-          }()) {}
+              size_t s = start > offset ? start - offset : 0;
+              size_t e = std::min(sgf.length(), end + offset);
+              return message + " at " + std::to_string(start) + ":" + std::to_string(end) + "\n" + sgf.substr(s, start - s) + highlight_start + sgf.substr(start, end - start) + highlight_end + sgf.substr(end, e - end);
+          }()),
+          start_(start), end_(end) {}
+
+    bool hasPosition() const { return start_ != npos && end_ != npos; }
+
+    size_t start_;
+    size_t end_;
 };
 
 class LexicalError : public BaseSGFException {
 public:
-    LexicalError(const std::string& message, int start, int end, bool detail = false, const std::string& sgf = "", int offset = 20, const std::string& highlight_start = "\033[1;31m", const std::string& highlight_end = "\033[0m")
+    LexicalError(const std::string& message, size_t start, size_t end, bool detail = false, const std::string& sgf = "", size_t offset = 20, const std::string& highlight_start = "\033[1;31m", const std::string& highlight_end = "\033[0m")
         : BaseSGFException(message, start, end, detail, sgf, offset, highlight_start, highlight_end) {}
 };
 
 class SGFError : public BaseSGFException {
 public:
-    SGFError(const std::string& message, int start, int end, bool detail = false, const std::string& sgf = "", int offset = 20, const std::string& highlight_start = "\033[1;31m", const std::string& highlight_end = "\033[0m")
+    SGFError(const std::string& message, size_t start, size_t end, bool detail = false, const std::string& sgf = "", size_t offset = 20, const std::string& highlight_start = "\033[1;31m", const std::string& highlight_end = "\033[0m")
         : BaseSGFException(message, start, end, detail, sgf, offset, highlight_start, highlight_end) {}
 };
+
+/**
+ * @brief The input stream ended early, e.g. a truncated compressed file; the stream cannot tell where.
+ */
+class SGFTruncatedError : public BaseSGFException {
+public:
+    explicit SGFTruncatedError(const std::string& message)
+        : BaseSGFException(message, npos, npos) {}
+};
+
+/**
+ * @brief Where a parser in recovery mode stopped, see SGFParser::setRecovery.
+ */
+struct SGFRecovery {
+    bool recovered = false; // the input was truncated or malformed, the tree is its valid prefix
+    std::string error;      // what() of the error that ended the prefix
+    size_t error_start = 0;
+    size_t error_end = 0;
+    size_t closed_variations = 0; // variations still open at the error
+
+    std::string toString() const
+    {
+        if (!recovered) {
+            return "SGFRecovery(none)";
+        }
+        return "SGFRecovery(error=" + error + ", position=" + std::to_string(error_start) + ":" + std::to_string(error_end) + ", closed_variations=" + std::to_string(closed_variations) + ")";
+    }
+};
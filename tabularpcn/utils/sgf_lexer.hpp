@@ -1,11 +1,22 @@
 #pragma once
 
 #include "sgf_exceptions.hpp"
+#include "sgf_load_stats.hpp"
+#include "sgf_scanner.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fcntl.h>
 #include <fstream>
 #include <functional>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 enum class SGFTokenType : int {
     LEFT_PAREN,
@@ -17,25 +28,54 @@ enum class SGFTokenType : int {
     ENDOFFILE,
     NONE,
 };
+static_assert(static_cast<size_t>(SGFTokenType::NONE) < SGFLoadStats::NUM_TOKEN_TYPES, "SGFLoadStats::tokens is too small");
 
+/**
+ * @brief A lexed token.
+ *
+ * `value` is a view that stays valid until the next token is read. When the
+ * input stream is contiguous it points straight into the source buffer and
+ * stays valid for the lifetime of the stream.
+ */
 class SGFToken {
 public:
-    SGFToken(SGFTokenType type, const std::string& value, int start, int end)
+    SGFToken(SGFTokenType type, std::string_view value, size_t start, size_t end)
         : type(type), value(value), start(start), end(end) {}
 
     SGFTokenType type;
-    std::string value;
+    std::string_view value;
     size_t start;
     size_t end;
 };
 
+/**
+ * @brief How often a progress callback runs while lexing.
+ *
+ * The callback runs once `bytes` more input was read since the last call,
+ * or once `milliseconds` passed, whichever comes first. Both are checked
+ * against token ends, so a token is never split and no stream position is
+ * queried; the clock is only read every SGFLexer::CLOCK_INTERVAL bytes.
+ */
+struct SGFProgressInterval {
+    static constexpr size_t NEVER = std::numeric_limits<size_t>::max();
+
+    size_t bytes = 1 << 16;    // 0 to report after every token
+    uint32_t milliseconds = 0; // 0 for no time limit
+
+    static SGFProgressInterval everyBytes(size_t bytes) { return {bytes, 0}; }
+    static SGFProgressInterval everyMilliseconds(uint32_t milliseconds) { return {NEVER, milliseconds}; }
+};
+
 class BaseInputStream {
 public:
+    // contiguous streams also provide data(), size() and seekg() over the whole input
+    static constexpr bool contiguous = false;
+
     virtual ~BaseInputStream() = default;
     virtual char peek() = 0;
     virtual char get() = 0;
     virtual void unget() = 0;
-    virtual int tellg() = 0;
+    virtual size_t tellg() = 0;
 };
 
 class FileInputStream : public BaseInputStream {
@@ -53,12 +93,12 @@ public:
         file.close();
     }
 
-    char peek() override
+    char peek() final
     {
         return file.peek();
     }
 
-    char get() override
+    char get() final
     {
         char c = file.get();
         if (file.eof()) {
@@ -67,12 +107,12 @@ public:
         return c;
     }
 
-    void unget() override
+    void unget() final
     {
         file.unget();
     }
 
-    int tellg() override
+    size_t tellg() final
     {
         return file.tellg();
     }
@@ -86,7 +126,10 @@ public:
     explicit StringInputStream(const std::string& s)
         : s(s), index(0) {}
 
-    char peek() override
+    explicit StringInputStream(std::string&& s)
+        : s(std::move(s)), index(0) {}
+
+    char peek() final
     {
         if (index >= s.length()) {
             return '\0';
@@ -94,7 +137,7 @@ public:
         return s[index];
     }
 
-    char get() override
+    char get() final
     {
         if (index >= s.length()) {
             return '\0';
@@ -102,33 +145,187 @@ public:
         return s[index++];
     }
 
-    void unget() override
+    void unget() final
     {
         if (index > 0) {
             --index;
         }
     }
 
-    int tellg() override
+    size_t tellg() final
     {
         return index;
     }
 
+    void seekg(size_t pos) { index = pos; }
+    const char* data() const { return s.data(); }
+    size_t size() const { return s.size(); }
+
+    static constexpr bool contiguous = true;
+
 private:
     std::string s;
     size_t index;
 };
 
+/**
+ * @brief Input stream over a contiguous, non-owning character buffer.
+ *
+ * The buffer must outlive the stream. A '\0' byte is treated as the end of
+ * input, same as the other streams.
+ */
+class MemoryInputStream : public BaseInputStream {
+public:
+    MemoryInputStream(const char* data, size_t size)
+        : data_(data), size_(size), index_(0) {}
+
+    char peek() final
+    {
+        if (index_ >= size_) {
+            return '\0';
+        }
+        return data_[index_];
+    }
+
+    char get() final
+    {
+        if (index_ >= size_) {
+            return '\0';
+        }
+        return data_[index_++];
+    }
+
+    void unget() final
+    {
+        if (index_ > 0) {
+            --index_;
+        }
+    }
+
+    size_t tellg() final
+    {
+        return index_;
+    }
+
+    void seekg(size_t pos) { index_ = pos; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    static constexpr bool contiguous = true;
+
+protected:
+    MemoryInputStream() : data_(nullptr), size_(0), index_(0) {}
+
+    const char* data_;
+    size_t size_;
+    size_t index_;
+};
+
+/**
+ * @brief Input stream over a memory-mapped file.
+ *
+ * The whole file is mapped read-only, so the lexer scans a contiguous buffer
+ * instead of going through std::ifstream for every character.
+ */
+class MappedFileInputStream : public MemoryInputStream {
+public:
+    explicit MappedFileInputStream(const std::string& filename)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::invalid_argument("Cannot open file: " + filename);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::invalid_argument("Cannot stat file: " + filename);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot map file: " + filename);
+            }
+            ::madvise(addr, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(addr);
+        }
+        ::close(fd); // the mapping stays valid after the descriptor is closed
+    }
+
+    // copy
+    MappedFileInputStream(const MappedFileInputStream&) = delete;
+    MappedFileInputStream& operator=(const MappedFileInputStream&) = delete;
+
+    ~MappedFileInputStream()
+    {
+        close();
+    }
+
+    void close()
+    {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+            data_ = nullptr;
+        }
+        size_ = 0;
+        index_ = 0;
+    }
+};
+
+/**
+ * @brief SGF lexer over an input stream type.
+ *
+ * With a concrete stream type (e.g. MemoryInputStream) the per-character
+ * stream calls are resolved statically and can be inlined. The default
+ * BaseInputStream goes through the virtual interface.
+ */
+template <typename InputStream = BaseInputStream>
 class SGFLexer {
 public:
-    SGFLexer(BaseInputStream& input_stream, size_t start = 0, size_t length = 0, std::function<void(size_t, size_t)> progress_callback = nullptr)
-        : length_(length), input_stream_(input_stream), last_token_(SGFTokenType::NONE, "", start, start), progress_callback_(std::move(progress_callback)) {}
+    // bytes between two reads of the clock for SGFProgressInterval::milliseconds
+    static constexpr size_t CLOCK_INTERVAL = 1 << 12;
+
+    SGFLexer(InputStream& input_stream, size_t start = 0, size_t length = 0, std::function<void(size_t, size_t)> progress_callback = nullptr)
+        : length_(length), input_stream_(input_stream), last_token_(SGFTokenType::NONE, "", start, start), progress_callback_(std::move(progress_callback)), reported_(start), scanned_(start)
+    {
+        setProgressInterval(SGFProgressInterval());
+    }
+
+    /**
+     * @brief Change how often the progress callback runs, counting from the last report.
+     */
+    void setProgressInterval(SGFProgressInterval interval)
+    {
+        progress_interval_ = interval;
+        if (progress_callback_ && interval.milliseconds > 0) {
+            reported_time_ = std::chrono::steady_clock::now();
+        }
+        scheduleProgress(reported_);
+    }
+
+    /**
+     * @brief Count the tokens and scanned bytes into `stats`, see SGFLoadStats.
+     */
+    void setStats(SGFLoadStats* stats)
+    {
+        stats_ = stats;
+    }
 
     const SGFToken& nextToken()
     {
         _nextToken();
-        if (last_token_.type != SGFTokenType::ENDOFFILE && progress_callback_) {
-            progress_callback_(input_stream_.tellg(), length_);
+        if constexpr (SGFLoadStats::enabled) {
+            if (stats_ != nullptr) {
+                ++stats_->tokens[static_cast<size_t>(last_token_.type)];
+                if (last_token_.type != SGFTokenType::ENDOFFILE) { // std::ifstream has no position at the end
+                    stats_->bytes_scanned += last_token_.end - scanned_;
+                    scanned_ = last_token_.end;
+                }
+            }
+        }
+        if (last_token_.type != SGFTokenType::ENDOFFILE && last_token_.end >= next_progress_ && progress_callback_) {
+            updateProgress();
         }
         return last_token_;
     }
@@ -139,28 +336,67 @@ public:
     }
 
 private:
+    // the end of the token is the stream position, so reporting does not need tellg
+    void updateProgress()
+    {
+        size_t position = last_token_.end;
+        bool due = position - reported_ >= progress_interval_.bytes;
+        if (!due && progress_interval_.milliseconds > 0) {
+            auto now = std::chrono::steady_clock::now();
+            due = now - reported_time_ >= std::chrono::milliseconds(progress_interval_.milliseconds);
+        }
+        if (due) {
+            progress_callback_(position, length_);
+            reported_ = position;
+            if (progress_interval_.milliseconds > 0) {
+                reported_time_ = std::chrono::steady_clock::now();
+            }
+        }
+        scheduleProgress(position);
+    }
+
+    // the next position at which updateProgress has to look
+    void scheduleProgress(size_t position)
+    {
+        size_t bytes = progress_interval_.bytes;
+        next_progress_ = bytes > SGFProgressInterval::NEVER - reported_ ? SGFProgressInterval::NEVER : reported_ + bytes;
+        if (progress_interval_.milliseconds > 0) {
+            next_progress_ = std::min(next_progress_, position + CLOCK_INTERVAL);
+        }
+    }
+
     void _nextToken()
     {
         while (true) {
+            if constexpr (InputStream::contiguous) {
+                const char* data = input_stream_.data();
+                input_stream_.seekg(SGFScanner::skipWhitespace(data + input_stream_.tellg(), data + input_stream_.size()) - data);
+            }
             char c = input_stream_.get();
             if (c == '\0') {
-                last_token_ = SGFToken(SGFTokenType::ENDOFFILE, "", input_stream_.tellg(), input_stream_.tellg());
+                last_token_ = SGFToken(SGFTokenType::ENDOFFILE, std::string_view(), input_stream_.tellg(), input_stream_.tellg());
                 return;
             }
             if (c == '(') {
-                last_token_ = SGFToken(SGFTokenType::LEFT_PAREN, std::string(1, c), input_stream_.tellg() - 1, input_stream_.tellg());
+                last_token_ = SGFToken(SGFTokenType::LEFT_PAREN, "(", input_stream_.tellg() - 1, input_stream_.tellg());
                 return;
             }
             if (c == ')') {
-                last_token_ = SGFToken(SGFTokenType::RIGHT_PAREN, std::string(1, c), input_stream_.tellg() - 1, input_stream_.tellg());
+                last_token_ = SGFToken(SGFTokenType::RIGHT_PAREN, ")", input_stream_.tellg() - 1, input_stream_.tellg());
                 return;
             }
             if (c == ';') {
-                last_token_ = SGFToken(SGFTokenType::SEMICOLON, std::string(1, c), input_stream_.tellg() - 1, input_stream_.tellg());
+                last_token_ = SGFToken(SGFTokenType::SEMICOLON, ";", input_stream_.tellg() - 1, input_stream_.tellg());
                 return;
             }
             if (c == '[') {
-                std::string value;
+                size_t start = input_stream_.tellg();
+                if constexpr (InputStream::contiguous) {
+                    size_t end = scanValue(start);
+                    last_token_ = SGFToken(SGFTokenType::VALUE, slice(start, end - 1), start, end);
+                    return;
+                }
+                buffer_.clear();
                 bool escape = false;
                 while (true) {
                     c = input_stream_.get();
@@ -170,27 +406,30 @@ private:
                     if (c == ']' && !escape) {
                         break;
                     }
-                    if (c == '\\' && !escape) {
-                        value += c; // Add the escape character
-                        escape = true;
-                        continue;
-                    }
-                    value += c;
-                    escape = false;
+                    buffer_ += c; // escape characters are kept in the value
+                    escape = c == '\\' && !escape;
                 }
-                last_token_ = SGFToken(SGFTokenType::VALUE, value, input_stream_.tellg() - value.size() - 1, input_stream_.tellg());
+                size_t end = input_stream_.tellg();
+                last_token_ = SGFToken(SGFTokenType::VALUE, slice(start, end - 1), start, end);
                 return;
             }
             if (isAlnum(c) || c == '_') {
-                std::string tag(1, c);
+                size_t start = input_stream_.tellg() - 1;
+                if constexpr (!InputStream::contiguous) {
+                    buffer_.assign(1, c);
+                }
                 while (true) {
                     c = input_stream_.peek();
-                    if (c == '\0' || !isAlnum(c) && c != '_') {
+                    if (c == '\0' || (!isAlnum(c) && c != '_')) {
                         break;
                     }
-                    tag += input_stream_.get();
+                    input_stream_.get();
+                    if constexpr (!InputStream::contiguous) {
+                        buffer_ += c;
+                    }
                 }
-                last_token_ = SGFToken(SGFTokenType::TAG, tag, input_stream_.tellg() - tag.size(), input_stream_.tellg());
+                size_t end = input_stream_.tellg();
+                last_token_ = SGFToken(SGFTokenType::TAG, slice(start, end), start, end);
                 return;
             }
             if (isspace(c)) {
@@ -200,13 +439,61 @@ private:
         }
     }
 
+    /**
+     * @brief Scan a property value of a contiguous stream, starting right after '['.
+     *
+     * @return size_t The position right after the closing ']'.
+     */
+    size_t scanValue(size_t start)
+    {
+        const char* data = input_stream_.data();
+        const char* end = data + input_stream_.size();
+        const char* p = data + start;
+        while (true) {
+            p = SGFScanner::findValueDelimiter(p, end);
+            if (p != end && *p == '\\') {
+                ++p; // the escaped character is part of the value
+                if (p != end && *p != '\0') {
+                    ++p;
+                    continue;
+                }
+            }
+            if (p == end || *p == '\0') {
+                size_t pos = p == end ? input_stream_.size() : p - data + 1;
+                input_stream_.seekg(pos);
+                throw LexicalError("Unexpected end of file", pos, pos);
+            }
+            input_stream_.seekg(p - data + 1); // skip ']'
+            return p - data + 1;
+        }
+    }
+
+    /**
+     * @brief View of the source text in [start, end), or of the token buffer if the stream is not contiguous.
+     */
+    std::string_view slice(size_t start, size_t end) const
+    {
+        if constexpr (InputStream::contiguous) {
+            return std::string_view(input_stream_.data() + start, end - start);
+        } else {
+            return buffer_;
+        }
+    }
+
     static bool isAlnum(char c)
     {
         return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
     }
 
     size_t length_;
-    BaseInputStream& input_stream_;
+    InputStream& input_stream_;
     SGFToken last_token_;
+    std::string buffer_; // token text for non-contiguous streams
     std::function<void(size_t, size_t)> progress_callback_;
+    SGFProgressInterval progress_interval_;
+    size_t reported_;      // position of the last progress report
+    std::chrono::steady_clock::time_point reported_time_;
+    size_t next_progress_ = 0;
+    size_t scanned_;       // end of the last token counted in stats_
+    SGFLoadStats* stats_ = nullptr;
 };
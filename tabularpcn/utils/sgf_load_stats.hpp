@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Counters and per-phase timers of an SGF load.
+ *
+ * Only filled when TABULARPCN_ENABLE_STATS is defined. Otherwise the hooks
+ * in the lexer, parser and loader compile to nothing and every field stays 0.
+ * Timing every token costs about two clock reads, so enable this for
+ * profiling builds only.
+ */
+struct SGFLoadStats {
+#ifdef TABULARPCN_ENABLE_STATS
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    enum Phase : int {
+        LEX,       // SGFLexer::nextToken
+        PROPERTY,  // addProperty, including the comment fields
+        ADD_CHILD, // node allocation and addChild
+        SIZES,     // dfsTreeSize or dfsTranspositionTreeSize
+        TOTAL,     // the whole load
+        NUM_PHASES,
+    };
+    static constexpr size_t NUM_TOKEN_TYPES = 8; // SGFTokenType
+
+    double seconds[NUM_PHASES] = {};
+    size_t tokens[NUM_TOKEN_TYPES] = {}; // indexed by SGFTokenType
+    size_t bytes_scanned = 0;
+    size_t nodes_allocated = 0;
+    size_t property_bytes_retained = 0; // tags and values kept by the nodes, or their source ranges
+    size_t max_sibling_chain = 0;       // largest number of children of a node
+
+    /**
+     * @brief Add the stats of another load, e.g. of another thread. Times are summed, not overlapped.
+     */
+    void merge(const SGFLoadStats& other)
+    {
+        for (int phase = 0; phase < NUM_PHASES; ++phase) { seconds[phase] += other.seconds[phase]; }
+        for (size_t type = 0; type < NUM_TOKEN_TYPES; ++type) { tokens[type] += other.tokens[type]; }
+        bytes_scanned += other.bytes_scanned;
+        nodes_allocated += other.nodes_allocated;
+        property_bytes_retained += other.property_bytes_retained;
+        max_sibling_chain = std::max(max_sibling_chain, other.max_sibling_chain);
+    }
+
+    std::string toString() const
+    {
+        static const char* phase_names[NUM_PHASES] = {"lex", "property", "add_child", "sizes", "total"};
+        static const char* token_names[NUM_TOKEN_TYPES] = {"(", ")", ";", "tag", "value", "ignore", "eof", "none"};
+        std::ostringstream oss;
+        oss << "SGFLoadStats(";
+        for (int phase = 0; phase < NUM_PHASES; ++phase) {
+            oss << phase_names[phase] << "=" << seconds[phase] << "s, ";
+        }
+        oss << "tokens={";
+        for (size_t type = 0; type < NUM_TOKEN_TYPES; ++type) {
+            oss << (type == 0 ? "" : ", ") << token_names[type] << ": " << tokens[type];
+        }
+        oss << "}, "
+            << "bytes_scanned=" << bytes_scanned << ", "
+            << "nodes_allocated=" << nodes_allocated << ", "
+            << "property_bytes_retained=" << property_bytes_retained << ", "
+            << "max_sibling_chain=" << max_sibling_chain
+            << ")";
+        return oss.str();
+    }
+};
+
+/**
+ * @brief Add the time of a scope to a phase of `stats`, if stats are enabled and `stats` is not nullptr.
+ */
+class SGFStatsTimer {
+public:
+    SGFStatsTimer(SGFLoadStats* stats, SGFLoadStats::Phase phase)
+    {
+        if constexpr (SGFLoadStats::enabled) {
+            if (stats != nullptr) {
+                stats_ = stats;
+                phase_ = phase;
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+    }
+
+    // copy
+    SGFStatsTimer(const SGFStatsTimer&) = delete;
+    SGFStatsTimer& operator=(const SGFStatsTimer&) = delete;
+
+    ~SGFStatsTimer()
+    {
+        if constexpr (SGFLoadStats::enabled) {
+            if (stats_ != nullptr) {
+                stats_->seconds[phase_] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+            }
+        }
+    }
+
+private:
+    SGFLoadStats* stats_ = nullptr;
+    SGFLoadStats::Phase phase_ = SGFLoadStats::TOTAL;
+    std::chrono::steady_clock::time_point start_;
+};
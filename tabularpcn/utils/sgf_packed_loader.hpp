@@ -0,0 +1,201 @@
+#pragma once
+
+#include "../tree/packed_tree.hpp"
+#include "sgf_tree_loader.hpp"
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Payload of a PackedTree with what training needs: the node type, the solved flag and the move.
+ *
+ * PackedNode<SGFSolvePayload> is 16 bytes. addProperty is called without
+ * virtual dispatch, so to keep more fields derive from this payload, add
+ * the fields and hide addProperty with one that calls this one first.
+ */
+struct SGFSolvePayload {
+    void addProperty(std::string_view tag, const std::vector<std::string_view>& values)
+    {
+        if (tag == "B") {
+            assert(values.size() == 1);
+            type_ = TreeNode::Type::OR;
+            move_ = SGFTreeNode::packMove(values[0]);
+        } else if (tag == "W") {
+            assert(values.size() == 1);
+            type_ = TreeNode::Type::AND;
+            move_ = SGFTreeNode::packMove(values[0]);
+        } else if (tag == "C") {
+            assert(values.size() == 1);
+            commentFields().extract(*this, values[0]);
+        }
+    }
+
+    /**
+     * @brief Fields extracted from every `C` property, see SGFTreeNode::commentFields.
+     *
+     * Handlers of a derived payload can cast the node to their own type.
+     */
+    static SGFCommentFields<SGFSolvePayload>& commentFields()
+    {
+        static SGFCommentFields<SGFSolvePayload> fields = [] {
+            SGFCommentFields<SGFSolvePayload> defaults;
+            defaults.add("solver_status: ", [](SGFSolvePayload& node, std::string_view value) {
+                if (value == "WIN" || value == "LOSS") {
+                    node.solved_ = true;
+                }
+            });
+            return defaults;
+        }();
+        return fields;
+    }
+
+    TreeNode::Type type_ = TreeNode::Type::NONE;
+    bool solved_ = false;
+    uint16_t move_ = SGFTreeNode::NO_MOVE; // SGFTreeNode::packMove of the B or W value
+};
+static_assert(sizeof(PackedNode<SGFSolvePayload>) == 16, "PackedNode<SGFSolvePayload> should stay 16 bytes");
+
+/**
+ * @brief Builder of SGFParser that appends the nodes to a PackedTree and fills their payload.
+ */
+template <typename Payload>
+class SGFPackedBuilder {
+public:
+    using Node = typename PackedTree<Payload>::Index;
+    static constexpr Node NONE = PackedTree<Payload>::NONE;
+
+    explicit SGFPackedBuilder(PackedTree<Payload>& tree) : tree_(tree) {}
+
+    Node root() { return NONE; }
+
+    Node createChild(Node parent)
+    {
+        if (parent == NONE && !tree_.empty()) {
+            throw std::runtime_error("PackedTree can only have one root");
+        }
+        return tree_.createNode(parent);
+    }
+
+    void addProperty(Node node, std::string_view tag, const std::vector<std::string_view>& values)
+    {
+        tree_[node].addProperty(tag, values);
+    }
+
+    void closeNode(Node) {}
+    void finish() {}
+
+private:
+    PackedTree<Payload>& tree_;
+};
+
+/**
+ * @brief Load SGF files into a PackedTree, for tools that only need a small payload per node.
+ *
+ * The payload is a template parameter instead of a node class, so parsing
+ * makes no virtual calls and a node takes 16 bytes with SGFSolvePayload,
+ * against more than 100 for an SGFTreeNode. The sizes are computed by
+ * PackedTree::computeSizes. Features that walk node pointers (arenas,
+ * transpositions, streaming and parallel loads) remain in SGFTreeLoader.
+ */
+template <typename Payload = SGFSolvePayload>
+class SGFPackedLoader {
+public:
+    using TreeType = PackedTree<Payload>;
+
+    /**
+     * @see SGFTreeLoader::setProgressCallback
+     */
+    void setProgressCallback(std::function<void(size_t position, size_t length)> callback)
+    {
+        progress_callback_ = std::move(callback);
+    }
+
+    /**
+     * @see SGFTreeLoader::setProgressInterval
+     */
+    void setProgressInterval(SGFProgressInterval interval)
+    {
+        progress_interval_ = interval;
+    }
+
+    /**
+     * @see SGFTreeLoader::setRecoveryMode
+     */
+    void setRecoveryMode(bool enabled)
+    {
+        recovery_mode_ = enabled;
+    }
+
+    const SGFRecovery& getRecovery() const
+    {
+        return recovery_;
+    }
+
+    /**
+     * @brief Counters and phase times of the last load, see SGFTreeLoader::getLoadStats.
+     *
+     * The payload keeps no properties and sibling chains are not walked, so those are not counted.
+     */
+    const SGFLoadStats& getLoadStats() const
+    {
+        return stats_;
+    }
+
+    TreeType loadFromString(const std::string& sgf_string)
+    {
+        StringInputStream input(sgf_string);
+        return loadSgf(input);
+    }
+
+    /**
+     * @brief Load a tree from an SGF file, possibly compressed, see SGFTreeLoader::loadFromFile.
+     */
+    TreeType loadFromFile(const std::string& sgf_path, bool memory_mapped = false)
+    {
+        if (CompressedFileInputStream::detect(sgf_path) != Compression::NONE) {
+            CompressedFileInputStream input(sgf_path);
+            return loadSgf(input);
+        }
+        if (memory_mapped) {
+            MappedFileInputStream input(sgf_path);
+            return loadSgf(input);
+        }
+        FileInputStream input(sgf_path);
+        return loadSgf(input);
+    }
+
+private:
+    template <typename InputStream>
+    TreeType loadSgf(InputStream& input_stream)
+    {
+        stats_ = SGFLoadStats();
+        recovery_ = SGFRecovery();
+        SGFStatsTimer timer(&stats_, SGFLoadStats::TOTAL);
+        TreeType tree;
+        size_t length = 0;
+        if constexpr (InputStream::contiguous) {
+            length = input_stream.size();
+        }
+        SGFParser<InputStream, SGFPackedBuilder<Payload>> parser(input_stream, SGFPackedBuilder<Payload>(tree), 0, length, progress_callback_);
+        parser.setProgressInterval(progress_interval_);
+        parser.setStats(&stats_);
+        if (recovery_mode_) {
+            parser.setRecovery(&recovery_);
+        }
+        while (parser.nextNode() != SGFPackedBuilder<Payload>::NONE);
+
+        SGFStatsTimer sizes_timer(&stats_, SGFLoadStats::SIZES);
+        tree.computeSizes();
+        return tree;
+    }
+
+    std::function<void(size_t, size_t)> progress_callback_;
+    SGFProgressInterval progress_interval_;
+    bool recovery_mode_ = false;
+    SGFRecovery recovery_;
+    SGFLoadStats stats_;
+};
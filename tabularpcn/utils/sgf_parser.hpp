@@ -1,29 +1,39 @@
 #pragma once
 
+#include "../tree/node_pool.hpp"
 #include "../tree/tree.hpp"
 #include "sgf_exceptions.hpp"
 #include "sgf_lexer.hpp"
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <stack>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <unordered_set>
 #include <vector>
 
 class BaseSGFNode : public TreeNode {
 public:
-    virtual void addProperty(const std::string& tag, const std::vector<std::string>& values) = 0;
+    /**
+     * @brief Add a property to the node.
+     *
+     * The views are only valid during the call; copy them if they need to be kept.
+     */
+    virtual void addProperty(std::string_view tag, const std::vector<std::string_view>& values) = 0;
 };
 
 class StringSGFNode : public BaseSGFNode {
 public:
     StringSGFNode() : BaseSGFNode() {}
 
-    void addProperty(const std::string& tag, const std::vector<std::string>& values) override
+    void addProperty(std::string_view tag, const std::vector<std::string_view>& values) override
     {
         content_ += tag;
         tag_value_sizes_.push_back(tag.size());
         is_tag_.push_back(true);
-        for (const std::string& value : values) {
+        for (std::string_view value : values) {
             content_ += value;
             tag_value_sizes_.push_back(value.size());
             is_tag_.push_back(false);
@@ -56,12 +66,19 @@ public:
     }
 };
 
+/**
+ * @brief Allocator that keeps track of its nodes and frees them all at once.
+ *
+ * Nodes come from a NodePool, so deallocateAll recycles them in one pass
+ * over the pool's slabs and later parses reuse them without allocating.
+ * The set of live nodes makes individual deallocations O(1) in any order.
+ */
 template <typename NodeType>
 class TrackingNodeAllocator : public BaseNodeAllocator {
 public:
     BaseSGFNode* allocate() override
     {
-        NodeType* node = new NodeType();
+        NodeType* node = pool_.acquire();
         allocated_nodes.insert(node);
         return node;
     }
@@ -69,7 +86,7 @@ public:
     void deallocate(BaseSGFNode* node) override
     {
         if (allocated_nodes.erase(static_cast<NodeType*>(node)) > 0) {
-            delete node;
+            pool_.release(static_cast<NodeType*>(node));
         }
     }
 
@@ -80,17 +97,19 @@ public:
 
     void deallocateAll()
     {
-        for (NodeType* node : allocated_nodes) {
-            delete node;
-        }
+        pool_.releaseAll();
         allocated_nodes.clear();
     }
 
 private:
+    NodePool<NodeType> pool_;
     std::unordered_set<NodeType*> allocated_nodes;
 };
 
-class SGFParser {
+/**
+ * @brief The default builder of SGFParser: nodes from a BaseNodeAllocator, linked with addChild and filled by their virtual addProperty.
+ */
+class SGFNodeBuilder {
     class DummyNode : public BaseSGFNode {
     public:
         DummyNode() : BaseSGFNode() {}
@@ -101,14 +120,90 @@ class SGFParser {
                 throw std::runtime_error("DummyNode can only have one child");
             }
             child_ = node;
+            last_child_ = node;
         }
 
-        void addProperty(const std::string& tag, const std::vector<std::string>& values) override
+        void addProperty(std::string_view tag, const std::vector<std::string_view>& values) override
         {
             throw std::runtime_error("DummyNode cannot have properties");
         }
     };
 
+public:
+    using Node = BaseSGFNode*;
+    static constexpr Node NONE = nullptr;
+
+    explicit SGFNodeBuilder(BaseNodeAllocator& allocator) : allocator_(allocator), dummy_root_(std::make_unique<DummyNode>()) {}
+
+    /**
+     * @see SGFParser::setNodeCloseCallback
+     */
+    void setNodeCloseCallback(std::function<void(BaseSGFNode*)> callback)
+    {
+        node_close_callback_ = std::move(callback);
+    }
+
+    Node root() { return dummy_root_.get(); }
+
+    Node createChild(Node parent)
+    {
+        Node node = allocator_.allocate();
+        parent->addChild(node);
+        return node;
+    }
+
+    void addProperty(Node node, std::string_view tag, const std::vector<std::string_view>& values)
+    {
+        node->addProperty(tag, values);
+    }
+
+    void closeNode(Node node)
+    {
+        if (!node_close_callback_) {
+            return;
+        }
+        if (dummy_root_->child_ == node) { // hand the top-level node over to the callback
+            dummy_root_->child_ = nullptr;
+            dummy_root_->last_child_ = nullptr;
+        }
+        node_close_callback_(node);
+    }
+
+    // remove the dummy root
+    void finish()
+    {
+        BaseSGFNode* root_child = static_cast<BaseSGFNode*>(dummy_root_->child_);
+        if (root_child != nullptr) {
+            root_child->detach();
+        }
+    }
+
+private:
+    BaseNodeAllocator& allocator_;
+    std::unique_ptr<DummyNode> dummy_root_;
+    std::function<void(BaseSGFNode*)> node_close_callback_;
+};
+
+/**
+ * @brief Parse SGF tokens into a tree of nodes.
+ *
+ * What a node is and how it is filled is up to the Builder, which the
+ * parser calls without virtual dispatch:
+ *
+ * - `Node`, a handle the parser keeps on its stack, and `NONE`, no node;
+ * - `Node root()`, the parent of the game tree;
+ * - `Node createChild(Node parent)`, called in preorder;
+ * - `void addProperty(Node node, std::string_view tag, const std::vector<std::string_view>& values)`;
+ * - `void closeNode(Node node)`, once the subtree of the node is complete;
+ * - `void finish()`, at the end of the input.
+ *
+ * SGFNodeBuilder builds BaseSGFNode objects from a BaseNodeAllocator; see
+ * SGFPackedBuilder for nodes without a vtable.
+ */
+template <typename InputStream = BaseInputStream, typename Builder = SGFNodeBuilder>
+class SGFParser {
+    using Node = typename Builder::Node;
+
     // stack element
     struct Element {
         enum class Type {
@@ -117,7 +212,7 @@ class SGFParser {
         } type;
         size_t start;
         size_t end;
-        BaseSGFNode* node;
+        Node node;
     };
 
     // valid next states
@@ -130,24 +225,91 @@ class SGFParser {
     };
 
 public:
-    SGFParser(BaseInputStream& input_stream, BaseNodeAllocator& allocator, size_t start = 0, size_t length = 0, std::function<void(size_t, size_t)> progress_callback = nullptr)
-        : lexer_(input_stream, start, length, std::move(progress_callback)), allocator_(allocator), dummy_root_(new DummyNode()), current_(dummy_root_)
+    SGFParser(InputStream& input_stream, BaseNodeAllocator& allocator, size_t start = 0, size_t length = 0, std::function<void(size_t, size_t)> progress_callback = nullptr)
+        : lexer_(input_stream, start, length, std::move(progress_callback)), builder_(allocator), current_(builder_.root())
     {
         next_state_ = NextState::LEFT_PAREN;
     }
 
-    ~SGFParser()
+    SGFParser(InputStream& input_stream, Builder&& builder, size_t start = 0, size_t length = 0, std::function<void(size_t, size_t)> progress_callback = nullptr)
+        : lexer_(input_stream, start, length, std::move(progress_callback)), builder_(std::move(builder)), current_(builder_.root())
     {
-        delete dummy_root_;
+        next_state_ = NextState::LEFT_PAREN;
     }
 
-    BaseSGFNode* nextNode()
+    /**
+     * @brief Call `callback(node)` whenever the subtree of a node is complete.
+     *
+     * Nodes are closed children first, when the variation containing them
+     * ends. The callback may detach and deallocate the node, in which case
+     * the pointers returned by nextNode must not be used either.
+     */
+    void setNodeCloseCallback(std::function<void(BaseSGFNode*)> callback)
     {
-        auto cache_tag = std::string();
-        auto cache_values = std::vector<std::string>();
+        builder_.setNodeCloseCallback(std::move(callback));
+    }
 
+    /**
+     * @brief Change how often the progress callback runs, see SGFProgressInterval.
+     */
+    void setProgressInterval(SGFProgressInterval interval)
+    {
+        lexer_.setProgressInterval(interval);
+    }
+
+    /**
+     * @brief Collect the counters and phase times of this parser into `stats`, see SGFLoadStats.
+     */
+    void setStats(SGFLoadStats* stats)
+    {
+        stats_ = stats;
+        lexer_.setStats(stats);
+    }
+
+    /**
+     * @brief Stop at the first error instead of throwing, keeping the tree parsed so far.
+     *
+     * On a truncated or malformed input (an SGFError, a LexicalError or an
+     * SGFTruncatedError of the stream) the property being read keeps the
+     * values read so far, every open variation is closed as if by ')', and
+     * nextNode ends as at the end of the input. Other errors, e.g. of the
+     * node allocator, are thrown. `recovery` reports whether and where that
+     * happened. Valid input is parsed exactly as without recovery.
+     */
+    void setRecovery(SGFRecovery* recovery)
+    {
+        recovery_ = recovery;
+    }
+
+    /**
+     * @brief Parse until the properties of the next node are complete.
+     *
+     * @return Node The node, or Builder::NONE at the end of the input.
+     */
+    Node nextNode()
+    {
+        if (recovery_ == nullptr) {
+            return parse();
+        }
+        if (stopped_) {
+            builder_.finish();
+            return Builder::NONE;
+        }
+        try {
+            return parse();
+        } catch (const BaseSGFException& error) {
+            if (!error.hasPosition()) { // std::ifstream at its end, or an SGFTruncatedError: located after the last token
+                return recover(error.what(), lexer_.currentToken().end, lexer_.currentToken().end);
+            }
+            return recover(error.what(), error.start_, error.end_);
+        }
+    }
+
+private:
+    Node parse()
+    {
         while (true) {
-            const SGFToken& token = lexer_.nextToken();
+            const SGFToken& token = nextToken();
             if (token.type == SGFTokenType::ENDOFFILE) {
                 break;
             }
@@ -158,7 +320,7 @@ public:
                     }
 
                     stack_.push({Element::Type::NODE, 0, 0, current_});
-                    stack_.push({Element::Type::LEFT_PAREN, token.start, token.end, nullptr}); // append '(' token to stack
+                    stack_.push({Element::Type::LEFT_PAREN, token.start, token.end, Builder::NONE}); // append '(' token to stack
 
                     // update states
                     next_state_ = NextState::SEMICOLON;
@@ -174,14 +336,14 @@ public:
                     }
 
                     // store tag and value to current node if needed
-                    BaseSGFNode* return_node = nullptr;
-                    if (!cache_values.empty()) {
-                        current_->addProperty(cache_tag, cache_values);
-                        cache_values.clear(); // not needed because the cache will be released after the node is returned
+                    Node return_node = Builder::NONE;
+                    if (hasCachedValues()) {
+                        flushProperty(current_);
                         return_node = current_;
                     }
 
-                    // pop until '('
+                    // pop until '(', the nodes of this sequence are complete (deepest first)
+                    closeNode(current_);
                     while (true) {
                         if (stack_.empty()) {
                             throw SGFError("Unmatched right parentheses", token.start, token.end);
@@ -190,7 +352,11 @@ public:
                             stack_.pop(); // pop '(' token
                             break;
                         }
+                        Node node = stack_.top().node;
                         stack_.pop(); // pop node
+                        if (!stack_.empty() && stack_.top().type != Element::Type::LEFT_PAREN) {
+                            closeNode(node); // the node right after '(' is the parent of the sequence
+                        }
                     }
                     current_ = stack_.top().node; // pop the node before '('
                     stack_.pop();
@@ -199,7 +365,7 @@ public:
                     next_state_ = NextState::LEFT_PAREN | NextState::RIGHT_PAREN;
 
                     // return the node if needed
-                    if (return_node != nullptr) {
+                    if (return_node != Builder::NONE) {
                         return return_node;
                     }
                     break;
@@ -210,39 +376,45 @@ public:
                     }
 
                     // store tag and value to current node if needed
-                    BaseSGFNode* return_node = nullptr;
-                    if (!cache_values.empty()) {
-                        current_->addProperty(cache_tag, cache_values);
-                        // cache_values.clear();  // not needed because the cache will be released after the node is returned
+                    Node return_node = Builder::NONE;
+                    if (hasCachedValues()) {
+                        flushProperty(current_);
                         return_node = current_;
                     }
 
-                    // create a new node
-                    stack_.push({Element::Type::NODE, 0, 0, current_});
-                    current_ = allocator_.allocate();
-                    stack_.top().node->addChild(current_);
+                    // create a new node, the stack only changes once it exists
+                    {
+                        SGFStatsTimer timer(stats_, SGFLoadStats::ADD_CHILD);
+                        Node parent = current_;
+                        current_ = builder_.createChild(parent);
+                        stack_.push({Element::Type::NODE, 0, 0, parent});
+                        if constexpr (SGFLoadStats::enabled) {
+                            if (stats_ != nullptr) {
+                                ++stats_->nodes_allocated;
+                            }
+                        }
+                    }
 
                     // update states
                     next_state_ = NextState::TAG;
 
                     // return the node if needed
-                    if (return_node != nullptr) {
+                    if (return_node != Builder::NONE) {
                         return return_node;
                     }
                     break;
                 }
                 case SGFTokenType::TAG: {
                     if (!(next_state_ & NextState::TAG)) {
-                        throw SGFError("Unexpected tag " + token.value, token.start, token.end);
+                        throw SGFError("Unexpected tag " + std::string(token.value), token.start, token.end);
                     }
 
                     // store tag and value to current node if needed
-                    if (!cache_values.empty()) {
-                        current_->addProperty(cache_tag, cache_values);
-                        cache_values.clear();
+                    if (hasCachedValues()) {
+                        flushProperty(current_);
                     }
 
-                    cache_tag = token.value; // cache the tag, will be used when the value comes
+                    cacheTag(token.value); // cache the tag, will be used when the value comes
 
                     // update states
                     next_state_ = NextState::VALUE;
@@ -250,10 +422,10 @@ public:
                 }
                 case SGFTokenType::VALUE: {
                     if (!(next_state_ & NextState::VALUE)) {
-                        throw SGFError("Unexpected value " + token.value, token.start, token.end);
+                        throw SGFError("Unexpected value " + std::string(token.value), token.start, token.end);
                     }
 
-                    cache_values.push_back(token.value);
+                    cacheValue(token.value);
 
                     // update states
                     next_state_ = NextState::LEFT_PAREN | NextState::RIGHT_PAREN | NextState::SEMICOLON | NextState::TAG | NextState::VALUE;
@@ -262,12 +434,15 @@ public:
                 case SGFTokenType::IGNORE:
                     break;
                 default:
-                    throw SGFError("Unexpected token " + token.value, token.start, token.end);
+                    throw SGFError("Unexpected token " + std::string(token.value), token.start, token.end);
                     break;
             }
         }
 
         // make sure all the parentheses are matched
+        if (!stack_.empty() && recovery_ != nullptr) {
+            return recover("", 0, 0);
+        }
         if (!stack_.empty()) {
             // pop until the first '(' token
             Element last_left_paren;
@@ -282,20 +457,119 @@ public:
             throw SGFError("Unmatched left parentheses", last_left_paren.start, last_left_paren.end);
         }
 
-        // remove the dummy root
-        BaseSGFNode* root_child = static_cast<BaseSGFNode*>(dummy_root_->child_);
-        if (root_child != nullptr) {
-            root_child->detach();
+        builder_.finish();
+        return Builder::NONE;
+    }
+
+    // End the input at an error (an empty one for a truncated input, located at the innermost '(')
+    // and close the open variations like ')' does, children first.
+    Node recover(std::string error, size_t start, size_t end)
+    {
+        stopped_ = true;
+        Node return_node = Builder::NONE;
+        if (hasCachedValues()) {
+            flushProperty(current_);
+            return_node = current_;
+        }
+        size_t closed = 0;
+        while (!stack_.empty()) {
+            if (stack_.top().type == Element::Type::NODE) { // close the sequence up to its '('
+                closeNode(current_);
+                while (stack_.top().type != Element::Type::LEFT_PAREN) {
+                    Node node = stack_.top().node;
+                    stack_.pop();
+                    if (stack_.top().type != Element::Type::LEFT_PAREN) {
+                        closeNode(node);
+                    }
+                }
+            }
+            if (closed++ == 0 && error.empty()) {
+                error = "Unmatched left parentheses";
+                start = stack_.top().start;
+                end = stack_.top().end;
+            }
+            stack_.pop(); // pop '(' token
+            current_ = stack_.top().node;
+            stack_.pop();
+        }
+        *recovery_ = {true, std::move(error), start, end, closed};
+        if (return_node == Builder::NONE) {
+            builder_.finish();
         }
+        return return_node;
+    }
 
-        return nullptr;
+    const SGFToken& nextToken()
+    {
+        SGFStatsTimer timer(stats_, SGFLoadStats::LEX);
+        return lexer_.nextToken();
     }
 
-private:
-    SGFLexer lexer_;
-    BaseNodeAllocator& allocator_;
+    void closeNode(Node node)
+    {
+        builder_.closeNode(node);
+    }
+
+    // Token views into a contiguous stream stay valid, so they are cached as-is.
+    // Otherwise the text is copied into buffers whose capacity is reused across properties.
+    void cacheTag(std::string_view tag)
+    {
+        if constexpr (InputStream::contiguous) {
+            cache_tag_ = tag;
+        } else {
+            tag_buffer_.assign(tag);
+        }
+    }
+
+    void cacheValue(std::string_view value)
+    {
+        if constexpr (InputStream::contiguous) {
+            cache_values_.push_back(value);
+        } else {
+            if (num_cached_values_ == value_buffers_.size()) {
+                value_buffers_.emplace_back();
+            }
+            value_buffers_[num_cached_values_++].assign(value);
+        }
+    }
+
+    bool hasCachedValues() const
+    {
+        if constexpr (InputStream::contiguous) {
+            return !cache_values_.empty();
+        } else {
+            return num_cached_values_ > 0;
+        }
+    }
+
+    void flushProperty(Node node)
+    {
+        if constexpr (!InputStream::contiguous) {
+            cache_tag_ = tag_buffer_;
+            for (size_t i = 0; i < num_cached_values_; ++i) {
+                cache_values_.push_back(value_buffers_[i]);
+            }
+            num_cached_values_ = 0;
+        }
+        {
+            SGFStatsTimer timer(stats_, SGFLoadStats::PROPERTY);
+            builder_.addProperty(node, cache_tag_, cache_values_);
+        }
+        cache_values_.clear();
+    }
+
+    SGFLexer<InputStream> lexer_;
+    Builder builder_;
     std::stack<Element> stack_;
-    BaseSGFNode* dummy_root_;
-    BaseSGFNode* current_;
+    Node current_;
     uint16_t next_state_ = 0;
+    SGFLoadStats* stats_ = nullptr;
+    SGFRecovery* recovery_ = nullptr;
+    bool stopped_ = false; // by recover
+
+    std::string_view cache_tag_;
+    std::vector<std::string_view> cache_values_;
+    std::string tag_buffer_;
+    std::vector<std::string> value_buffers_;
+    size_t num_cached_values_ = 0;
 };
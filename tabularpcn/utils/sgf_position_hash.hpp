@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../tree/tree.hpp"
+#include <cstdint>
+
+/**
+ * @brief Zobrist-style hashing of positions reached by a sequence of B/W moves.
+ *
+ * The hash of a path is the sum (mod 2^64) of the keys of its moves, so
+ * transpositions (the same moves in another order) hash equal. A player can
+ * repeat a move, a pass or a recapture after a capture, and a sum keeps
+ * every occurrence where XOR would cancel two equal keys. The position key
+ * adds the player who made the last move. Keys are derived with the
+ * splitmix64 finalizer, so no key table is needed for any board size.
+ */
+class SGFPositionHash {
+public:
+    static constexpr uint16_t PASS = 0; // packed move of a pass, see SGFTreeNode::packMove
+    static constexpr uint16_t NO_MOVE = 0xffff; // nodes without a B/W property, e.g. the root or setup nodes
+
+    static uint64_t mix(uint64_t value)
+    {
+        value += 0x9e3779b97f4a7c15ULL;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    /**
+     * @brief Key of a move, 0 for nodes without a move (Type::NONE or NO_MOVE).
+     *
+     * @param move The packed coordinates, see SGFTreeNode::packMove.
+     */
+    static uint64_t moveKey(TreeNode::Type type, uint16_t move)
+    {
+        if (type == TreeNode::Type::NONE || move == NO_MOVE) {
+            return 0;
+        }
+        return mix(uint64_t(static_cast<uint8_t>(type)) << 16 | move);
+    }
+
+    /**
+     * @brief Hash of the moves from the root to a node, extended one child at a time.
+     */
+    struct Path {
+        /**
+         * @brief The path of a child that plays `move`.
+         */
+        Path extend(TreeNode::Type type, uint16_t move) const
+        {
+            return Path{hash + moveKey(type, move)};
+        }
+
+        uint64_t hash = 0;
+    };
+
+    /**
+     * @brief Key of the position after a path with the given hash, ending at a node of the given type.
+     */
+    static uint64_t positionKey(uint64_t path_hash, TreeNode::Type type)
+    {
+        return path_hash ^ mix(uint64_t(1) << 32 | static_cast<uint8_t>(type));
+    }
+};
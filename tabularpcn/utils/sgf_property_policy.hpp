@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Which SGF properties a loaded node keeps.
+ *
+ * The node type, solved flags and comment fields are always extracted; the
+ * policy only decides what is stored for toSgf and snapshots:
+ *   - ALL keeps every property (the default),
+ *   - NONE keeps nothing,
+ *   - WHITELIST keeps the listed tags only,
+ *   - SOURCE keeps the byte range of the node's properties in the source
+ *     and decodes them again when they are needed. The source must stay
+ *     mapped, which SGFTreeLoader ensures by attaching it to the tree.
+ */
+class SGFPropertyPolicy {
+public:
+    enum class Mode : uint8_t {
+        ALL,
+        NONE,
+        WHITELIST,
+        SOURCE,
+    };
+
+public:
+    static SGFPropertyPolicy all() { return SGFPropertyPolicy(Mode::ALL); }
+    static SGFPropertyPolicy none() { return SGFPropertyPolicy(Mode::NONE); }
+    static SGFPropertyPolicy source() { return SGFPropertyPolicy(Mode::SOURCE); }
+
+    static SGFPropertyPolicy whitelist(std::vector<std::string> tags)
+    {
+        SGFPropertyPolicy policy(Mode::WHITELIST);
+        policy.tags_ = std::move(tags);
+        return policy;
+    }
+
+    /**
+     * @brief Whether a property with this tag is stored in properties_.
+     */
+    bool keeps(std::string_view tag) const
+    {
+        switch (mode_) {
+            case Mode::ALL: return true;
+            case Mode::WHITELIST: return std::find(tags_.begin(), tags_.end(), tag) != tags_.end();
+            default: return false;
+        }
+    }
+
+public:
+    Mode mode_;
+    std::vector<std::string> tags_; // WHITELIST only
+
+private:
+    explicit SGFPropertyPolicy(Mode mode) : mode_(mode) {}
+};
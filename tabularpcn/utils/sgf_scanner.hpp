@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if !defined(TABULARPCN_NO_SIMD)
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <immintrin.h>
+#define TABULARPCN_SCANNER_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TABULARPCN_SCANNER_NEON 1
+#endif
+#endif
+
+/**
+ * @brief Byte scanning primitives used by SGFLexer on contiguous input.
+ *
+ * x86 uses SSE2 and switches to AVX2 at runtime when the CPU supports it,
+ * ARM uses NEON, and everything else falls back to the scalar loops. Define
+ * TABULARPCN_NO_SIMD to force the scalar loops.
+ */
+class SGFScanner {
+public:
+    /**
+     * @brief Find the first byte in [p, end) that ends or escapes a property value.
+     *
+     * @return const char* Pointer to the first ']', '\\' or '\0', or end if there is none.
+     */
+    static const char* findValueDelimiter(const char* p, const char* end)
+    {
+        static const ScanFunction scan = selectValueDelimiter();
+        return scan(p, end);
+    }
+
+    /**
+     * @brief Skip whitespace (same set as isspace in the "C" locale).
+     *
+     * @return const char* Pointer to the first non-whitespace byte, or end if there is none.
+     */
+    static const char* skipWhitespace(const char* p, const char* end)
+    {
+        // whitespace runs between tokens are usually short, check the first byte before vectorizing
+        if (p == end || !isWhitespace(*p)) {
+            return p;
+        }
+        static const ScanFunction scan = selectWhitespace();
+        return scan(p + 1, end);
+    }
+
+    static bool isWhitespace(char c)
+    {
+        return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+    }
+
+    static bool isValueDelimiter(char c)
+    {
+        return c == ']' || c == '\\' || c == '\0';
+    }
+
+private:
+    using ScanFunction = const char* (*)(const char*, const char*);
+
+    static const char* findValueDelimiterScalar(const char* p, const char* end)
+    {
+        while (p != end && !isValueDelimiter(*p)) { ++p; }
+        return p;
+    }
+
+    static const char* skipWhitespaceScalar(const char* p, const char* end)
+    {
+        while (p != end && isWhitespace(*p)) { ++p; }
+        return p;
+    }
+
+#if defined(TABULARPCN_SCANNER_X86)
+    static const char* findValueDelimiterSSE2(const char* p, const char* end)
+    {
+        const __m128i right_bracket = _mm_set1_epi8(']');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i zero = _mm_setzero_si128();
+        while (end - p >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, right_bracket), _mm_cmpeq_epi8(v, backslash)), _mm_cmpeq_epi8(v, zero));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+        return findValueDelimiterScalar(p, end);
+    }
+
+    static const char* skipWhitespaceSSE2(const char* p, const char* end)
+    {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i range = _mm_set1_epi8('\r' - '\t');
+        while (end - p >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i offset = _mm_sub_epi8(v, tab);
+            __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(offset, range), offset); // '\t' <= v <= '\r'
+            __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space), control);
+            unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(ws)) & 0xffffu;
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+        return skipWhitespaceScalar(p, end);
+    }
+
+    __attribute__((target("avx2"))) static const char* findValueDelimiterAVX2(const char* p, const char* end)
+    {
+        const __m256i right_bracket = _mm256_set1_epi8(']');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i zero = _mm256_setzero_si256();
+        while (end - p >= 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, right_bracket), _mm256_cmpeq_epi8(v, backslash)), _mm256_cmpeq_epi8(v, zero));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return findValueDelimiterSSE2(p, end);
+    }
+
+    __attribute__((target("avx2"))) static const char* skipWhitespaceAVX2(const char* p, const char* end)
+    {
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i tab = _mm256_set1_epi8('\t');
+        const __m256i range = _mm256_set1_epi8('\r' - '\t');
+        while (end - p >= 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i offset = _mm256_sub_epi8(v, tab);
+            __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, range), offset);
+            __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), control);
+            unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(ws));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return skipWhitespaceSSE2(p, end);
+    }
+
+    static bool hasAVX2()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+
+    static ScanFunction selectValueDelimiter() { return hasAVX2() ? findValueDelimiterAVX2 : findValueDelimiterSSE2; }
+    static ScanFunction selectWhitespace() { return hasAVX2() ? skipWhitespaceAVX2 : skipWhitespaceSSE2; }
+#elif defined(TABULARPCN_SCANNER_NEON)
+    // horizontal max and min of the lanes, vmaxvq_u8 and vminvq_u8 only exist on AArch64
+    static uint8_t maxLane(uint8x16_t v)
+    {
+#if defined(__aarch64__)
+        return vmaxvq_u8(v);
+#else
+        uint8x8_t m = vpmax_u8(vget_low_u8(v), vget_high_u8(v));
+        m = vpmax_u8(m, m);
+        m = vpmax_u8(m, m);
+        m = vpmax_u8(m, m);
+        return vget_lane_u8(m, 0);
+#endif
+    }
+
+    static uint8_t minLane(uint8x16_t v)
+    {
+#if defined(__aarch64__)
+        return vminvq_u8(v);
+#else
+        uint8x8_t m = vpmin_u8(vget_low_u8(v), vget_high_u8(v));
+        m = vpmin_u8(m, m);
+        m = vpmin_u8(m, m);
+        m = vpmin_u8(m, m);
+        return vget_lane_u8(m, 0);
+#endif
+    }
+
+    static const char* findValueDelimiterNEON(const char* p, const char* end)
+    {
+        const uint8x16_t right_bracket = vdupq_n_u8(']');
+        const uint8x16_t backslash = vdupq_n_u8('\\');
+        const uint8x16_t zero = vdupq_n_u8(0);
+        while (end - p >= 16) {
+            uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+            uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, right_bracket), vceqq_u8(v, backslash)), vceqq_u8(v, zero));
+            if (maxLane(hit) != 0) {
+                return findValueDelimiterScalar(p, p + 16);
+            }
+            p += 16;
+        }
+        return findValueDelimiterScalar(p, end);
+    }
+
+    static const char* skipWhitespaceNEON(const char* p, const char* end)
+    {
+        const uint8x16_t space = vdupq_n_u8(' ');
+        const uint8x16_t tab = vdupq_n_u8('\t');
+        const uint8x16_t range = vdupq_n_u8('\r' - '\t');
+        while (end - p >= 16) {
+            uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+            uint8x16_t ws = vorrq_u8(vceqq_u8(v, space), vcleq_u8(vsubq_u8(v, tab), range));
+            if (minLane(ws) == 0) {
+                return skipWhitespaceScalar(p, p + 16);
+            }
+            p += 16;
+        }
+        return skipWhitespaceScalar(p, end);
+    }
+
+    static ScanFunction selectValueDelimiter() { return findValueDelimiterNEON; }
+    static ScanFunction selectWhitespace() { return skipWhitespaceNEON; }
+#else
+    static ScanFunction selectValueDelimiter() { return findValueDelimiterScalar; }
+    static ScanFunction selectWhitespace() { return skipWhitespaceScalar; }
+#endif
+};
@@ -1,55 +1,138 @@
 #pragma once
+#include "../tree/compact_tree.hpp"
+#include "../tree/subtree_index.hpp"
+#include "compressed_input_stream.hpp"
+#include "sgf_comment_fields.hpp"
+#include "sgf_load_stats.hpp"
 #include "sgf_parser.hpp"
+#include "sgf_position_hash.hpp"
+#include "sgf_property_policy.hpp"
+#include "sgf_writer.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <exception>
 #include <functional>
+#include <limits>
 #include <map>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <queue>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #pragma pack(push, 1)
 class SGFTreeNode : public BaseSGFNode {
 public:
-    void addProperty(const std::string& tag, const std::vector<std::string>& values) override
+    void addProperty(std::string_view tag, const std::vector<std::string_view>& values) override
     {
         if (tag == "B") {
             assert(values.size() == 1);
             type_ = Type::OR;
+            move_ = packMove(values[0]);
         }
         if (tag == "W") {
             assert(values.size() == 1);
             type_ = Type::AND;
+            move_ = packMove(values[0]);
         }
         if (tag == "C") {
             assert(values.size() == 1);
-            static auto get_property = [](const std::string& comment, const std::string& key) -> std::string {
-                size_t pos = comment.find(key);
-                if (pos == std::string::npos) {
-                    return "";
-                }
-                pos += key.size();
-                size_t end_pos = comment.find('\n', pos);
-                if (end_pos == std::string::npos) {
-                    end_pos = comment.size();
-                } else if (end_pos > 0 && comment[end_pos - 1] == '\r') {
-                    --end_pos;
-                }
-                return comment.substr(pos, end_pos - pos);
-            };
-            auto& comment = values[0];
-            std::string solver_status = get_property(comment, "solver_status: ");
-            if (solver_status == "WIN" || solver_status == "LOSS") {
-                solved_ = true;
-            }
-            match_tt_ = get_property(comment, "match_tt = ") == "true";
+            // a missing match_tt is false, a missing equal_loss counts as pruned
+            match_tt_ = false;
+            pruned_by_rzone_ = true;
+            commentFields().extract(*this, values[0]);
             assert(!match_tt_ || solved_);
-            pruned_by_rzone_ = get_property(comment, "equal_loss = ") != "-1";
             assert(!pruned_by_rzone_ || solved_);
         }
 
-        properties_.push_back({tag, values});
+        if (property_policy_ == nullptr || property_policy_->keeps(tag)) {
+            properties_.emplace_back(std::string(tag), std::vector<std::string>(values.begin(), values.end()));
+        } else if (property_policy_->mode_ == SGFPropertyPolicy::Mode::SOURCE) {
+            // tag and values point into the source, the range ends after the last ']'
+            if (source_ == nullptr) {
+                source_ = tag.data();
+            }
+            const std::string_view& last = values.back();
+            source_size_ = static_cast<uint32_t>(last.data() + last.size() + 1 - source_);
+        }
+    }
+
+    /**
+     * @brief Call `func(std::string_view tag, const std::vector<std::string_view>& values)` on every stored property.
+     *
+     * Properties kept as source offsets are lexed again from the source.
+     */
+    template <typename Func>
+    void forEachProperty(Func&& func) const
+    {
+        std::vector<std::string_view> views;
+        if (source_ != nullptr) {
+            MemoryInputStream input(source_, source_size_);
+            SGFLexer lexer(input);
+            std::string_view tag;
+            for (const SGFToken* token = &lexer.nextToken(); token->type != SGFTokenType::ENDOFFILE; token = &lexer.nextToken()) {
+                if (token->type == SGFTokenType::TAG) {
+                    if (!views.empty()) {
+                        func(tag, views);
+                        views.clear();
+                    }
+                    tag = token->value;
+                } else if (token->type == SGFTokenType::VALUE) {
+                    views.push_back(token->value);
+                }
+            }
+            if (!views.empty()) {
+                func(tag, views);
+            }
+        }
+        for (const auto& [tag, values] : properties_) {
+            views.assign(values.begin(), values.end());
+            func(std::string_view(tag), views);
+        }
+    }
+
+    /**
+     * @brief Fields extracted from every `C` property.
+     *
+     * Register additional keys here (before loading) to read more solver
+     * output into fields of a derived node type.
+     */
+    static SGFCommentFields<SGFTreeNode>& commentFields()
+    {
+        static SGFCommentFields<SGFTreeNode> fields = [] {
+            SGFCommentFields<SGFTreeNode> defaults;
+            defaults.add("solver_status: ", [](SGFTreeNode& node, std::string_view value) {
+                if (value == "WIN" || value == "LOSS") {
+                    node.solved_ = true;
+                }
+            });
+            defaults.add("match_tt = ", [](SGFTreeNode& node, std::string_view value) { node.match_tt_ = value == "true"; });
+            defaults.add("equal_loss = ", [](SGFTreeNode& node, std::string_view value) { node.pruned_by_rzone_ = value != "-1"; });
+            return defaults;
+        }();
+        return fields;
+    }
+
+    /**
+     * @brief The two coordinate letters of a move value, PASS for an empty or shorter value.
+     *
+     * Nodes without a B or W property keep NO_MOVE, which no pair of coordinate letters packs to.
+     */
+    static uint16_t packMove(std::string_view value)
+    {
+        if (value.size() < 2) {
+            return PASS;
+        }
+        return static_cast<uint16_t>(static_cast<uint8_t>(value[0]) << 8 | static_cast<uint8_t>(value[1]));
     }
 
     std::string toString() const
@@ -67,84 +150,56 @@ public:
 
     std::string toSgfString() const
     {
-        std::ostringstream oss;
-        return _toSgfString(oss).str();
+        std::string sgf;
+        SGFWriter(sgf).writeNode(*this);
+        return sgf;
     }
 
+    /**
+     * @brief The subtree as an SGF game tree, see SGFWriter to stream it to a file instead.
+     */
     std::string toSgf() const
     {
-        std::ostringstream oss;
-        return _toSgf(oss, true).str();
-    }
-
-private:
-    std::ostringstream& _toSgfString(std::ostringstream& oss) const
-    {
-        oss << ";";
-        for (const auto& [tag, values] : properties_) {
-            oss << tag;
-            if (tag != "C") {
-                for (const auto& value : values) {
-                    oss << "[" << value << "]";
-                }
-            } else {
-                oss << "[" << values[0] << "\n"
-                    << "id = " << id_ << "\n"
-                    << "type = " << typeToString(type_) << "\n"
-                    << "tree_size = " << tree_size_ << "\n"
-                    << "proof_tree_size = " << proof_tree_size_ << "\n"
-                    << "solved = " << (solved_ ? "true" : "false") << "\n"
-                    << "match_tt = " << (match_tt_ ? "true" : "false") << "\n"
-                    << "pruned_by_rzone = " << (pruned_by_rzone_ ? "true" : "false") << "]";
-            }
-        }
-        return oss;
-    }
-
-    std::ostringstream& _toSgf(std::ostringstream& oss, bool root) const
-    {
-        if (root) { oss << "("; }
-        if (next_sibling_) {
-            if (static_cast<SGFTreeNode*>(next_sibling_)->next_sibling_) {
-                oss << "(";
-                _toSgfString(oss);
-                if (child_) { static_cast<SGFTreeNode*>(child_)->_toSgf(oss, false); }
-                oss << ")";
-                static_cast<SGFTreeNode*>(next_sibling_)->_toSgf(oss, false);
-            } else {
-                oss << "(";
-                _toSgfString(oss);
-                if (child_) { static_cast<SGFTreeNode*>(child_)->_toSgf(oss, false); }
-                oss << ")(";
-                static_cast<SGFTreeNode*>(next_sibling_)->_toSgf(oss, false) << ")";
-            }
-        } else {
-            _toSgfString(oss);
-            if (child_) { static_cast<SGFTreeNode*>(child_)->_toSgf(oss, false); }
-        }
-        if (root) { oss << ")"; }
-        return oss;
+        std::string sgf;
+        SGFWriter(sgf).write(this);
+        return sgf;
     }
 
 public:
+    static constexpr uint16_t PASS = SGFPositionHash::PASS;
+    static constexpr uint16_t NO_MOVE = SGFPositionHash::NO_MOVE;
+
     bool match_tt_ = false;
     bool pruned_by_rzone_ = false;
+    uint16_t move_ = NO_MOVE; // packMove of the B or W value
 
     std::vector<std::pair<std::string, std::vector<std::string>>> properties_;
+    const SGFPropertyPolicy* property_policy_ = nullptr; // nullptr keeps every property
+    const char* source_ = nullptr; // properties kept as a range of the source (SGFPropertyPolicy::Mode::SOURCE)
+    uint32_t source_size_ = 0;
 };
 #pragma pack(pop)
 
-template <typename NodeType>
+/**
+ * @brief Load SGF files into a tree.
+ *
+ * @tparam NodeType The node type, usually SGFTreeNode or a subclass of it.
+ * @tparam TreeType The tree that owns the nodes, e.g. Tree<NodeType> or ArenaTree<NodeType>.
+ */
+template <typename NodeType, typename TreeType = Tree<NodeType>>
 class SGFTreeLoader {
+    // numbers the nodes in allocation order, unless `assign_ids` is false because the tree indexes them by id_ (see IsIndexedTree)
     class LambdaNodeAllocator : public BaseNodeAllocator {
     public:
-        LambdaNodeAllocator(std::function<NodeType*()> allocate_func, std::function<void(NodeType*)> deallocate_func)
-            : allocate_func_(allocate_func), deallocate_func_(deallocate_func) {}
+        LambdaNodeAllocator(std::function<NodeType*()> allocate_func, std::function<void(NodeType*)> deallocate_func, bool assign_ids = true)
+            : allocate_func_(allocate_func), deallocate_func_(deallocate_func), assign_ids_(assign_ids) {}
 
         BaseSGFNode* allocate() override
         {
             NodeType* node = allocate_func_();
-            node->id_ = id_counter_++;
+            if (assign_ids_) {
+                node->id_ = id_counter_++;
+            }
             return node;
         }
 
@@ -156,65 +211,1031 @@ class SGFTreeLoader {
     private:
         std::function<NodeType*()> allocate_func_;
         std::function<void(NodeType*)> deallocate_func_;
+        bool assign_ids_;
         size_t id_counter_ = 0;
     };
 
+    // allocates from a per-thread ArenaTree cursor, ids are assigned by the arena
+    class CursorNodeAllocator : public BaseNodeAllocator {
+    public:
+        CursorNodeAllocator(typename TreeType::Cursor& cursor, const SGFTreeLoader& loader) : cursor_(cursor), loader_(loader) {}
+
+        BaseSGFNode* allocate() override
+        {
+            NodeType* node = cursor_.createNode();
+            loader_.prepareNode(node);
+            return node;
+        }
+
+        void deallocate(BaseSGFNode*) override
+        {
+            throw std::logic_error("Nodes cannot be deallocated while loading in parallel");
+        }
+
+    private:
+        typename TreeType::Cursor& cursor_;
+        const SGFTreeLoader& loader_;
+    };
+
 public:
-    Tree<NodeType> loadFromString(const std::string& sgf_string)
+    /**
+     * @brief Choose which properties the loaded nodes keep.
+     *
+     * The policy is shared with every tree loaded afterwards. SOURCE keeps the
+     * input alive with the tree, so files are always memory-mapped then.
+     */
+    void setPropertyPolicy(SGFPropertyPolicy policy)
+    {
+        static_assert(std::is_base_of_v<SGFTreeNode, NodeType>, "property policies need an SGFTreeNode");
+        property_policy_ = std::make_shared<const SGFPropertyPolicy>(std::move(policy));
+    }
+
+    /**
+     * @brief Report `callback(size_t position, size_t length)` while loading.
+     *
+     * The callback runs every 64 KiB of input by default, see setProgressInterval.
+     * `length` is 0 when the input size is not known up front (std::ifstream
+     * and compressed input). loadMany reports the bytes of all files instead,
+     * and the variations of loadParallel are not reported.
+     */
+    void setProgressCallback(std::function<void(size_t position, size_t length)> callback)
+    {
+        progress_callback_ = std::move(callback);
+    }
+
+    /**
+     * @brief Change how often the progress callback runs, e.g. SGFProgressInterval::everyMilliseconds(100).
+     *
+     * loadMany applies the interval to every file.
+     */
+    void setProgressInterval(SGFProgressInterval interval)
+    {
+        progress_interval_ = interval;
+    }
+
+    /**
+     * @brief Compute the sizes after loading with `num_threads` threads, see dfsTreeSizeParallel.
+     *
+     * 1 (the default) keeps the sequential pass, 0 uses one thread per hardware thread.
+     */
+    void setSizeThreads(size_t num_threads)
+    {
+        size_threads_ = num_threads;
+    }
+
+    /**
+     * @brief Take the nodes of the loaded trees (and of streaming loads) from `pool`, see NodePool.
+     *
+     * Nodes go back to the pool when their tree is reset or destroyed, so
+     * loading one tree after another stops allocating once the pool holds
+     * enough slabs. The pool is not thread-safe: share it with trees of the
+     * same thread only. loadMany does not use it.
+     */
+    void setNodePool(std::shared_ptr<typename TreeType::node_pool_type> pool)
+    {
+        node_pool_ = std::move(pool);
+    }
+
+    /**
+     * @brief Keep the valid prefix of truncated or malformed inputs instead of throwing, see SGFParser::setRecovery.
+     *
+     * A solver that crashed leaves a truncated SGF: its open variations are
+     * closed at the end of the file (or at the first error) and the sizes are
+     * computed on what was read. getRecovery reports whether and where a load
+     * stopped early. loadParallel loads the inputs with an error sequentially
+     * (the workers stop at the error); loadMany recovers every file but does
+     * not report it.
+     */
+    void setRecoveryMode(bool enabled)
+    {
+        recovery_mode_ = enabled;
+    }
+
+    const SGFRecovery& getRecovery() const
+    {
+        return recovery_;
+    }
+
+    /**
+     * @brief Resolve the proof tree size of transposition hits after loading, see dfsTranspositionTreeSize.
+     */
+    void setTranspositionAware(bool enabled)
+    {
+        static_assert(std::is_base_of_v<SGFTreeNode, NodeType>, "transpositions need the moves of an SGFTreeNode");
+        transposition_aware_ = enabled;
+    }
+
+    /**
+     * @brief Counters and phase times of the last load, all 0 unless TABULARPCN_ENABLE_STATS is defined.
+     *
+     * The stats of loadMany are summed over the files. Streaming loads do not
+     * keep the nodes, so their retained property bytes and sibling chains are
+     * not counted.
+     */
+    const SGFLoadStats& getLoadStats() const
+    {
+        return stats_;
+    }
+
+    TreeType loadFromString(const std::string& sgf_string)
     {
+        if (keepsSource()) {
+            auto input = std::make_shared<StringInputStream>(sgf_string);
+            return loadSgf(*input, input);
+        }
         StringInputStream input(sgf_string);
         return loadSgf(input);
     }
 
-    Tree<NodeType> loadFromFile(const std::string& sgf_path)
+    /**
+     * @brief Load a tree from an SGF file.
+     *
+     * Compressed files (see CompressedFileInputStream) are detected by their
+     * magic bytes and decompressed while they are parsed.
+     *
+     * @param sgf_path Path to the SGF file.
+     * @param memory_mapped Map the whole file into memory instead of reading it through std::ifstream.
+     */
+    TreeType loadFromFile(const std::string& sgf_path, bool memory_mapped = false)
     {
+        if (CompressedFileInputStream::detect(sgf_path) != Compression::NONE) {
+            if (keepsSource()) {
+                auto input = std::make_shared<StringInputStream>(CompressedFileInputStream::readAll(sgf_path));
+                return loadSgf(*input, input);
+            }
+            CompressedFileInputStream input(sgf_path);
+            return loadSgf(input);
+        }
+        if (keepsSource()) {
+            auto input = std::make_shared<MappedFileInputStream>(sgf_path);
+            return loadSgf(*input, input);
+        }
+        if (memory_mapped) {
+            MappedFileInputStream input(sgf_path);
+            return loadSgf(input);
+        }
         FileInputStream input(sgf_path);
         return loadSgf(input);
     }
 
+    /**
+     * @brief Load a tree from an SGF string, parsing the top-level variations in parallel.
+     *
+     * @see loadParallel
+     */
+    TreeType loadParallelFromString(const std::string& sgf_string, size_t num_threads = 0)
+    {
+        auto input = std::make_shared<StringInputStream>(sgf_string);
+        return loadParallel(*input, num_threads, keepsSource() ? input : nullptr);
+    }
+
+    /**
+     * @brief Load a tree from a memory-mapped SGF file, parsing the top-level variations in parallel.
+     *
+     * Compressed files are decompressed into memory first.
+     *
+     * @see loadParallel
+     */
+    TreeType loadParallelFromFile(const std::string& sgf_path, size_t num_threads = 0)
+    {
+        if (CompressedFileInputStream::detect(sgf_path) != Compression::NONE) {
+            auto input = std::make_shared<StringInputStream>(CompressedFileInputStream::readAll(sgf_path));
+            return loadParallel(*input, num_threads, keepsSource() ? input : nullptr);
+        }
+        auto input = std::make_shared<MappedFileInputStream>(sgf_path);
+        return loadParallel(*input, num_threads, keepsSource() ? input : nullptr);
+    }
+
+    /**
+     * @brief Load many SGF files concurrently, one tree per file.
+     *
+     * @return std::vector<TreeType> The trees in the order of `sgf_paths`.
+     * @see loadMany(const std::vector<std::string>&, size_t, Callback&&)
+     */
+    std::vector<TreeType> loadMany(const std::vector<std::string>& sgf_paths, size_t num_threads = 0)
+    {
+        std::vector<TreeType> trees(sgf_paths.size());
+        loadMany(sgf_paths, num_threads, [&trees](size_t index, TreeType&& tree) { trees[index] = std::move(tree); });
+        return trees;
+    }
+
+    /**
+     * @brief Load many SGF files concurrently, passing each tree to `on_loaded(size_t index, TreeType&& tree)` as it completes.
+     *
+     * Every file is loaded memory-mapped (or decompressed) into its own tree
+     * by whichever worker is free, largest files first. `on_loaded` is called
+     * from the workers but never concurrently. The progress callback, which
+     * must be thread-safe here, receives the bytes loaded so far and the size
+     * of all files. After an error no new files are started, and the error of
+     * the first failed file is rethrown.
+     *
+     * @param num_threads Number of worker threads, 0 for one per hardware thread.
+     */
+    template <typename Callback>
+    void loadMany(const std::vector<std::string>& sgf_paths, size_t num_threads, Callback&& on_loaded)
+    {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        num_threads = std::max<size_t>(1, std::min(num_threads, sgf_paths.size()));
+        std::vector<size_t> sizes(sgf_paths.size(), 0);
+        size_t total_size = 0;
+        for (size_t i = 0; i < sgf_paths.size(); ++i) {
+            struct stat st;
+            if (::stat(sgf_paths[i].c_str(), &st) == 0) {
+                sizes[i] = static_cast<size_t>(st.st_size);
+                total_size += sizes[i];
+            }
+        }
+        std::vector<size_t> order(sgf_paths.size());
+        for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+        std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+        stats_ = SGFLoadStats();
+        recovery_ = SGFRecovery();
+        std::atomic<size_t> next(0);
+        std::atomic<size_t> loaded_size(0);
+        std::mutex callback_mutex;
+        std::vector<std::exception_ptr> errors(sgf_paths.size());
+        auto worker = [&]() {
+            for (size_t k = next++; k < order.size(); k = next++) {
+                size_t index = order[k];
+                size_t reported = 0; // bytes of this file added to loaded_size, at most its size
+                SGFTreeLoader loader(*this);
+                loader.node_pool_ = nullptr; // the pool is not thread-safe
+                if (progress_callback_) {
+                    loader.progress_callback_ = [&](size_t position, size_t) {
+                        size_t position_in_file = std::min(position, sizes[index]);
+                        if (position_in_file > reported) {
+                            size_t loaded = loaded_size += position_in_file - reported;
+                            reported = position_in_file;
+                            progress_callback_(loaded, total_size);
+                        }
+                    };
+                }
+                try {
+                    TreeType tree = loader.loadFromFile(sgf_paths[index], true);
+                    if (progress_callback_ && reported < sizes[index]) { // e.g. compressed or trailing whitespace
+                        progress_callback_(loaded_size += sizes[index] - reported, total_size);
+                    }
+                    std::lock_guard<std::mutex> lock(callback_mutex);
+                    stats_.merge(loader.stats_);
+                    on_loaded(index, std::move(tree));
+                } catch (...) {
+                    errors[index] = std::current_exception();
+                    next = order.size(); // stop the other workers
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < num_threads; ++t) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    /**
+     * @brief Stream the nodes of an SGF string to a sink without building the tree.
+     *
+     * @see loadStreaming
+     */
+    template <typename Sink>
+    size_t loadStreamingFromString(const std::string& sgf_string, Sink&& sink)
+    {
+        StringInputStream input(sgf_string);
+        return loadStreaming(input, sink);
+    }
+
+    /**
+     * @brief Stream the nodes of an SGF file to a sink without building the tree.
+     *
+     * @see loadStreaming
+     */
+    template <typename Sink>
+    size_t loadStreamingFromFile(const std::string& sgf_path, Sink&& sink, bool memory_mapped = false)
+    {
+        if (CompressedFileInputStream::detect(sgf_path) != Compression::NONE) {
+            if (keepsSource()) {
+                StringInputStream input(CompressedFileInputStream::readAll(sgf_path));
+                return loadStreaming(input, sink);
+            }
+            CompressedFileInputStream input(sgf_path);
+            return loadStreaming(input, sink);
+        }
+        if (memory_mapped || keepsSource()) {
+            MappedFileInputStream input(sgf_path);
+            return loadStreaming(input, sink);
+        }
+        FileInputStream input(sgf_path);
+        return loadStreaming(input, sink);
+    }
+
+    /**
+     * @brief Compute tree_size_ and proof_tree_size_ of a compact tree.
+     *
+     * Same rules as for the node tree, as a single reverse sweep over the
+     * preorder arrays: every node is final before it is added to its parent.
+     */
+    static void dfsTreeSize(CompactTree& tree)
+    {
+        std::fill(tree.tree_size_.begin(), tree.tree_size_.end(), 0);
+        std::fill(tree.proof_tree_size_.begin(), tree.proof_tree_size_.end(), 0);
+        for (CompactTree::Index i = tree.size(); i-- > 0;) {
+            // proof_tree_size_ of an OR node stays 0 until a solved child is seen, solved nodes are always >= 1
+            tree.tree_size_[i] += 1;
+            tree.proof_tree_size_[i] = tree.solved_[i] ? tree.proof_tree_size_[i] + 1 : 0;
+
+            CompactTree::Index parent = tree.parent_[i];
+            if (parent == CompactTree::NONE) {
+                continue;
+            }
+            tree.tree_size_[parent] += tree.tree_size_[i];
+            if (!tree.solved_[i]) {
+                continue;
+            }
+            if (tree.type_[parent] == NodeType::Type::AND) { // sum for AND node
+                tree.proof_tree_size_[parent] += tree.proof_tree_size_[i];
+            } else if (tree.type_[parent] == NodeType::Type::OR) { // min for OR node
+                CompactTree::Index& proof_tree_size = tree.proof_tree_size_[parent];
+                proof_tree_size = proof_tree_size == 0 ? tree.proof_tree_size_[i] : std::min(proof_tree_size, tree.proof_tree_size_[i]);
+            }
+        }
+    }
+
+    /**
+     * @brief Compute tree_size_ and proof_tree_size_ of every node in a loaded tree.
+     *
+     * Indexed trees (ArenaTree) are swept once in reverse creation order if
+     * every parent was created before its children, other trees are walked
+     * from the root.
+     */
+    static void dfsTreeSize(TreeType& tree)
+    {
+        if constexpr (IsIndexedTree<TreeType>::value) {
+            // nodes are created in document order, so every child has a larger id than its parent,
+            // unless subtrees were moved around after loading
+            bool ordered = true;
+            tree.forEachNode([&ordered](NodeType* node) {
+                startNode(node);
+                ordered = ordered && (node->parent_ == nullptr || static_cast<NodeType*>(node->parent_)->id_ < node->id_);
+            });
+            if (!ordered) {
+                if (tree.getRootNode() != nullptr) {
+                    dfsTreeSize(tree.getRootNode());
+                }
+                return;
+            }
+            for (size_t id = tree.getSlotCount(); id-- > 0;) {
+                NodeType* node = tree.getNode(id);
+                if (node == nullptr) {
+                    continue;
+                }
+                finishNode(node);
+                if (node->parent_ != nullptr) {
+                    addChildSize(static_cast<NodeType*>(node->parent_), node);
+                }
+            }
+        } else if (tree.getRootNode() != nullptr) {
+            dfsTreeSize(tree.getRootNode());
+        }
+    }
+
+    /**
+     * @brief Compute tree_size_ and proof_tree_size_ of every node, and rebuild `index` over the tree in the same walk.
+     */
+    static void dfsTreeSize(TreeType& tree, SubtreeIndex<NodeType>& index)
+    {
+        index.clear();
+        if (tree.getRootNode() != nullptr) {
+            dfsTreeSize(tree.getRootNode(), index);
+        }
+    }
+
+    /**
+     * @brief Compute tree_size_ and proof_tree_size_ of a subtree with an iterative post-order walk.
+     */
+    static void dfsTreeSize(NodeType* root)
+    {
+        walkTreeSize(root, nullptr);
+    }
+
+    /**
+     * @brief Same as dfsTreeSize(root), also appending the subtree to `index` (usually empty before).
+     */
+    static void dfsTreeSize(NodeType* root, SubtreeIndex<NodeType>& index)
+    {
+        walkTreeSize(root, &index);
+    }
+
+    /**
+     * @brief Compute tree_size_ and proof_tree_size_ of every node, evaluating independent subtrees in parallel.
+     *
+     * @see dfsTreeSizeParallel(NodeType*, size_t)
+     */
+    static void dfsTreeSizeParallel(TreeType& tree, size_t num_threads = 0)
+    {
+        if (tree.getRootNode() != nullptr) {
+            dfsTreeSizeParallel(tree.getRootNode(), num_threads);
+        }
+    }
+
+    /**
+     * @brief Compute tree_size_ and proof_tree_size_ of a subtree, evaluating independent subtrees in parallel.
+     *
+     * The top of the tree is expanded until there are enough subtrees for
+     * the threads, largest first by their previous tree_size_ where that is
+     * known. The subtrees are walked like dfsTreeSize by whichever thread is
+     * free, then the expanded nodes are finished children first. The result
+     * is the same as dfsTreeSize for any number of threads.
+     *
+     * @param num_threads Number of threads, 0 for one per hardware thread.
+     */
+    static void dfsTreeSizeParallel(NodeType* root, size_t num_threads = 0)
+    {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (num_threads == 1) {
+            dfsTreeSize(root);
+            return;
+        }
+
+        // expand the largest subtree until the subtrees are small enough, a long line stays mostly at the top
+        const size_t min_subtrees = 32 * num_threads;
+        const size_t max_expanded = size_t(1) << 16;
+        const size_t max_subtree_size = root->tree_size_ / (4 * num_threads); // 0 if the sizes are unknown
+        struct Subtree {
+            size_t size_hint;
+            size_t order;
+            NodeType* node;
+            bool operator<(const Subtree& other) const { return size_hint != other.size_hint ? size_hint < other.size_hint : order > other.order; }
+        };
+        std::priority_queue<Subtree> frontier;
+        std::vector<NodeType*> expanded; // parents before their children
+        std::vector<NodeType*> leaves;   // cannot be split further
+        size_t order = 0;
+        frontier.push({root->tree_size_, order++, root});
+        while (!frontier.empty() && expanded.size() < max_expanded) {
+            const Subtree& largest = frontier.top();
+            if (frontier.size() + leaves.size() >= min_subtrees && largest.size_hint <= max_subtree_size) {
+                break;
+            }
+            NodeType* node = largest.node;
+            frontier.pop();
+            if (node->child_ == nullptr) {
+                leaves.push_back(node);
+                continue;
+            }
+            expanded.push_back(node);
+            for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+                NodeType* child_node = static_cast<NodeType*>(child);
+                frontier.push({child_node->tree_size_, order++, child_node});
+            }
+        }
+        std::vector<NodeType*> subtrees;
+        subtrees.reserve(frontier.size() + leaves.size());
+        for (; !frontier.empty(); frontier.pop()) {
+            subtrees.push_back(frontier.top().node); // largest first
+        }
+        subtrees.insert(subtrees.end(), leaves.begin(), leaves.end());
+
+        std::vector<std::exception_ptr> errors(num_threads);
+        std::atomic<size_t> next(0);
+        auto worker = [&](size_t thread_index) {
+            try {
+                for (size_t k = next++; k < subtrees.size(); k = next++) {
+                    dfsTreeSize(subtrees[k]);
+                }
+            } catch (...) {
+                errors[thread_index] = std::current_exception();
+                next = subtrees.size(); // stop the other workers
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < std::min(num_threads, subtrees.size()); ++t) {
+            threads.emplace_back(worker, t);
+        }
+        worker(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        for (auto it = expanded.rbegin(); it != expanded.rend(); ++it) {
+            NodeType* node = *it;
+            startNode(node);
+            for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+                addChildSize(node, static_cast<NodeType*>(child));
+            }
+            finishNode(node);
+        }
+    }
+
+    /**
+     * @brief Compute the sizes like dfsTreeSize, resolving transposition hits to the real subtree.
+     *
+     * A node solved by a transposition table hit (match_tt_) usually has no
+     * proof below it. Here its proof_tree_size_ is taken from a solved node
+     * without match_tt_ that reaches the same position, i.e. the same multiset of
+     * B/W moves from the root (Zobrist hash) with the same player to move.
+     * Such nodes are always at the same depth, so the depths are computed
+     * bottom-up, each with a table of its solved positions: first the nodes
+     * with a real subtree, then the hits, which therefore also count for
+     * their ancestors. Hits without a match keep the dfsTreeSize value.
+     */
+    static void dfsTranspositionTreeSize(NodeType* root)
+    {
+        // breadth-first, so the nodes of every depth are contiguous
+        struct Entry {
+            NodeType* node;
+            SGFPositionHash::Path path; // the moves from the root to this node
+        };
+        std::vector<Entry> nodes;
+        std::vector<size_t> depth_begin = {0};
+        nodes.push_back({root, SGFPositionHash::Path().extend(root->type_, root->move_)});
+        for (size_t begin = 0; begin < nodes.size();) {
+            size_t end = nodes.size();
+            for (size_t i = begin; i < end; ++i) {
+                for (BaseTreeNode* child = nodes[i].node->child_; child != nullptr; child = child->next_sibling_) {
+                    NodeType* child_node = static_cast<NodeType*>(child);
+                    nodes.push_back({child_node, nodes[i].path.extend(child_node->type_, child_node->move_)});
+                }
+            }
+            depth_begin.push_back(end);
+            begin = end;
+        }
+
+        std::unordered_map<uint64_t, size_t> solved_proof_sizes;
+        for (size_t depth = depth_begin.size() - 1; depth-- > 0;) {
+            solved_proof_sizes.clear();
+            for (bool hits : {false, true}) {
+                for (size_t i = depth_begin[depth]; i < depth_begin[depth + 1]; ++i) {
+                    NodeType* node = nodes[i].node;
+                    if (node->match_tt_ != hits) {
+                        continue;
+                    }
+                    startNode(node);
+                    for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+                        addChildSize(node, static_cast<NodeType*>(child));
+                    }
+                    finishNode(node);
+                    if (!node->solved_) {
+                        continue;
+                    }
+                    uint64_t position = SGFPositionHash::positionKey(nodes[i].path.hash, node->type_);
+                    if (!hits) {
+                        auto [it, inserted] = solved_proof_sizes.emplace(position, node->proof_tree_size_);
+                        it->second = std::min(it->second, node->proof_tree_size_);
+                    } else if (auto it = solved_proof_sizes.find(position); it != solved_proof_sizes.end()) {
+                        node->proof_tree_size_ = it->second;
+                    }
+                }
+            }
+        }
+    }
+
 private:
-    Tree<NodeType> loadSgf(BaseInputStream& input_stream)
+    static void walkTreeSize(NodeType* root, SubtreeIndex<NodeType>* index)
     {
-        Tree<NodeType> tree;
-        LambdaNodeAllocator allocator(
-            [&tree]() -> NodeType* { return tree.createNode(); },
-            [&tree](NodeType* node) { tree.deleteNode(node); });
-        SGFParser parser(input_stream, allocator);
-        NodeType* root = static_cast<NodeType*>(parser.nextNode());
-        while (parser.nextNode());
+        using Index = typename SubtreeIndex<NodeType>::Index;
+        struct Frame {
+            NodeType* node;
+            BaseTreeNode* next_child;
+            Index index;
+        };
+        std::vector<Frame> stack;
+        startNode(root);
+        stack.push_back({root, root->child_, index == nullptr ? SubtreeIndex<NodeType>::NONE : index->enter(root, SubtreeIndex<NodeType>::NONE)});
+        while (!stack.empty()) {
+            BaseTreeNode* child = stack.back().next_child;
+            if (child != nullptr) {
+                stack.back().next_child = child->next_sibling_;
+                NodeType* child_node = static_cast<NodeType*>(child);
+                startNode(child_node);
+                Index child_index = index == nullptr ? SubtreeIndex<NodeType>::NONE : index->enter(child_node, stack.back().index);
+                stack.push_back({child_node, child_node->child_, child_index});
+                continue;
+            }
+            Frame frame = stack.back();
+            stack.pop_back();
+            finishNode(frame.node);
+            if (index != nullptr) {
+                index->leave(frame.index);
+            }
+            if (!stack.empty()) {
+                addChildSize(stack.back().node, frame.node);
+            }
+        }
+    }
+
+    void computeSizes(TreeType& tree)
+    {
+        SGFStatsTimer timer(&stats_, SGFLoadStats::SIZES);
+        if constexpr (std::is_base_of_v<SGFTreeNode, NodeType>) {
+            if (transposition_aware_ && tree.getRootNode() != nullptr) {
+                dfsTranspositionTreeSize(tree.getRootNode());
+                return;
+            }
+        }
+        if (size_threads_ != 1) {
+            dfsTreeSizeParallel(tree, size_threads_);
+            return;
+        }
+        dfsTreeSize(tree);
+    }
+
+    bool keepsSource() const
+    {
+        return property_policy_ != nullptr && property_policy_->mode_ == SGFPropertyPolicy::Mode::SOURCE;
+    }
+
+    template <typename InputStream>
+    static size_t inputLength(InputStream& input_stream)
+    {
+        if constexpr (InputStream::contiguous) {
+            return input_stream.size();
+        } else {
+            return 0;
+        }
+    }
+
+    void prepareNode(NodeType* node) const
+    {
+        if constexpr (std::is_base_of_v<SGFTreeNode, NodeType>) {
+            node->property_policy_ = property_policy_.get();
+        }
+    }
+
+    // the nodes refer to the policy and, with SOURCE, to the source itself
+    void attachResources(TreeType& tree, std::shared_ptr<const void> source) const
+    {
+        if (property_policy_ != nullptr) {
+            tree.attach(property_policy_);
+        }
+        if (source != nullptr) {
+            tree.attach(std::move(source));
+        }
+    }
+
+    /**
+     * @param source Owner of the input, attached to the tree when the nodes keep offsets into it.
+     */
+    template <typename InputStream>
+    TreeType loadSgf(InputStream& input_stream, std::shared_ptr<const void> source = nullptr)
+    {
+        stats_ = SGFLoadStats();
+        recovery_ = SGFRecovery();
+        SGFStatsTimer timer(&stats_, SGFLoadStats::TOTAL);
+        TreeType tree;
+        tree.setNodePool(node_pool_);
+        attachResources(tree, std::move(source));
+        tree.setRootNode(parseAll(input_stream, tree));
+        computeSizes(tree);
+        collectTreeStats(tree.getRootNode());
+        return tree;
+    }
+
+    /**
+     * @brief Load a contiguous SGF input, parsing the top-level variations in parallel.
+     *
+     * A pre-scan finds the variations directly below the main line of the
+     * game tree. The main line is parsed first, then every variation is
+     * parsed by its own SGFParser on a worker thread, filling its own slabs of
+     * the arena, and attached in document order. Inputs without at least two
+     * such variations are loaded sequentially, and so are inputs with a parse
+     * error, so that the error is the one of a sequential load.
+     *
+     * @param num_threads Number of worker threads, 0 for one per hardware thread.
+     */
+    template <typename InputStream>
+    TreeType loadParallel(InputStream& input_stream, size_t num_threads, std::shared_ptr<const void> source = nullptr)
+    {
+        static_assert(IsIndexedTree<TreeType>::value, "parallel loading needs an ArenaTree");
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const char* data = input_stream.data();
+        std::vector<std::pair<size_t, size_t>> variations;
+        if (num_threads == 1 || !findVariations(data, input_stream.size(), variations) || variations.size() < 2) {
+            return loadSgf(input_stream, std::move(source));
+        }
+        std::optional<TreeType> tree = tryLoadParallel(input_stream, variations, num_threads, source);
+        if (!tree) {
+            return loadSgf(input_stream, std::move(source));
+        }
+        return std::move(*tree);
+    }
+
+    /**
+     * @brief The parallel part of loadParallel, std::nullopt after a parse error.
+     */
+    template <typename InputStream>
+    std::optional<TreeType> tryLoadParallel(InputStream& input_stream, const std::vector<std::pair<size_t, size_t>>& variations, size_t num_threads, std::shared_ptr<const void> source)
+    {
+        // the main line, closed right before its first variation
+        const char* data = input_stream.data();
+        stats_ = SGFLoadStats();
+        recovery_ = SGFRecovery();
+        SGFStatsTimer timer(&stats_, SGFLoadStats::TOTAL);
+        TreeType tree;
+        tree.setNodePool(node_pool_); // the cursors take their slabs from it under the tree's lock
+        std::string main_line(data, variations.front().first);
+        main_line += ')';
+        auto main_input = std::make_shared<StringInputStream>(main_line);
+        attachResources(tree, std::move(source));
+        if (keepsSource()) {
+            tree.attach(main_input);
+        }
+        NodeType* root;
+        try {
+            root = parseAll(*main_input, tree);
+        } catch (const BaseSGFException&) {
+            return std::nullopt; // errors are located from the closing ')' added above
+        }
+        if (recovery_.recovered) {
+            return std::nullopt; // same, and the variations would be attached after the error
+        }
+        NodeType* branch = root;
+        while (branch->child_ != nullptr) {
+            branch = static_cast<NodeType*>(branch->child_);
+        }
+
+        // largest variations first, so the threads finish at about the same time
+        std::vector<size_t> order(variations.size());
+        for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return variations[a].second - variations[a].first > variations[b].second - variations[b].first;
+        });
+
+        std::vector<NodeType*> roots(variations.size(), nullptr);
+        std::vector<std::exception_ptr> errors(num_threads);
+        std::atomic<bool> parse_error(false);
+        std::vector<SGFLoadStats> thread_stats(num_threads);
+        std::atomic<size_t> next(0);
+        auto worker = [&](size_t thread_index) {
+            try {
+                typename TreeType::Cursor cursor(tree);
+                CursorNodeAllocator allocator(cursor, *this);
+                for (size_t k = next++; k < order.size(); k = next++) {
+                    auto [start, end] = variations[order[k]];
+                    MemoryInputStream input(data, end + 1); // positions stay relative to the whole input
+                    input.seekg(start);
+                    SGFParser parser(input, allocator, start);
+                    parser.setStats(&thread_stats[thread_index]);
+                    parser.setNodeCloseCallback([&](BaseSGFNode* node) {
+                        if (node->parent_ == nullptr) {
+                            roots[order[k]] = static_cast<NodeType*>(node);
+                        }
+                    });
+                    while (parser.nextNode());
+                }
+            } catch (const BaseSGFException&) {
+                parse_error = true; // the first error in the document may be in a variation not parsed yet
+                next = order.size(); // stop the other workers
+            } catch (...) {
+                errors[thread_index] = std::current_exception();
+                next = order.size();
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < num_threads; ++t) {
+            threads.emplace_back(worker, t);
+        }
+        worker(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        if (parse_error) {
+            return std::nullopt;
+        }
+
+        for (const SGFLoadStats& stats : thread_stats) {
+            stats_.merge(stats);
+        }
+
+        for (NodeType* variation : roots) {
+            branch->addChild(variation);
+        }
         tree.setRootNode(root);
-        dfsTreeSize(tree.getRootNode());
+        computeSizes(tree);
+        collectTreeStats(root);
         return tree;
     }
 
-    void dfsTreeSize(NodeType* node)
+    /**
+     * @brief Find the variations right below the main line of the only game tree.
+     *
+     * @param variations The [start, end] positions of the '(' and ')' of every such variation.
+     * @return bool False if the input is not a single well-formed game tree, e.g. unbalanced or truncated,
+     *              or if anything but whitespace follows the first variation at its level.
+     */
+    static bool findVariations(const char* data, size_t size, std::vector<std::pair<size_t, size_t>>& variations)
     {
-        if (node->num_children_ == 0) { // leaf node
-            node->tree_size_ = 1;
-            node->proof_tree_size_ = node->solved_ ? 1 : 0;
+        const char* end = data + size;
+        size_t depth = 0;
+        size_t start = 0;
+        bool closed = false;
+        bool in_variations = false; // a variation below the main line has been opened
+        for (const char* p = data; p != end && *p != '\0'; ++p) {
+            char c = *p;
+            if (closed && !SGFScanner::isWhitespace(c)) {
+                return false; // more than one game tree, or trailing garbage
+            }
+            if (in_variations && depth == 1 && c != '(' && c != ')' && !SGFScanner::isWhitespace(c)) {
+                return false; // nodes after a variation, the sequential parser reports the error
+            }
+            if (c == '[') {
+                while (true) { // skip the value, same rules as the lexer
+                    p = SGFScanner::findValueDelimiter(p + 1, end);
+                    if (p == end || *p == '\0') {
+                        return false;
+                    }
+                    if (*p == ']') {
+                        break;
+                    }
+                    if (++p == end) { // escaped character
+                        return false;
+                    }
+                }
+            } else if (c == '(') {
+                if (depth == 1) {
+                    start = p - data;
+                    in_variations = true;
+                }
+                ++depth;
+            } else if (c == ')') {
+                if (depth == 0) {
+                    return false;
+                }
+                if (--depth == 1) {
+                    variations.emplace_back(start, p - data);
+                }
+                closed = depth == 0;
+            }
+        }
+        return closed;
+    }
+
+    template <typename InputStream>
+    NodeType* parseAll(InputStream& input_stream, TreeType& tree)
+    {
+        NodeType* root = nullptr; // the first node, which nextNode does not return if it has no properties
+        LambdaNodeAllocator allocator(
+            [this, &tree, &root]() -> NodeType* {
+                NodeType* node = tree.createNode();
+                prepareNode(node);
+                if (root == nullptr) {
+                    root = node;
+                }
+                return node;
+            },
+            [&tree](NodeType* node) { tree.deleteNode(node); },
+            !IsIndexedTree<TreeType>::value);
+        SGFParser parser(input_stream, allocator, 0, inputLength(input_stream), progress_callback_);
+        parser.setProgressInterval(progress_interval_);
+        parser.setStats(&stats_);
+        if (recovery_mode_) {
+            parser.setRecovery(&recovery_);
+        }
+        while (parser.nextNode());
+        return root;
+    }
+
+    /**
+     * @brief Load an SGF bottom-up, keeping only the nodes whose subtree is still open.
+     *
+     * Every node is passed to `sink(const NodeType& node, const NodeType* parent)`
+     * once its subtree is complete, with final tree_size_ and proof_tree_size_,
+     * and is freed right after. Children come before their parent; `parent` is
+     * nullptr for the root and its sizes are still partial. Peak memory is
+     * bounded by the open path instead of the whole tree.
+     *
+     * @return size_t The number of nodes.
+     */
+    template <typename InputStream, typename Sink>
+    size_t loadStreaming(InputStream& input_stream, Sink& sink)
+    {
+        LambdaNodeAllocator allocator(
+            [this]() -> NodeType* {
+                NodeType* node = node_pool_ ? node_pool_->acquire() : new NodeType();
+                prepareNode(node);
+                return node;
+            },
+            [this](NodeType* node) {
+                if (node_pool_) {
+                    node_pool_->release(node);
+                } else {
+                    delete node;
+                }
+            });
+        stats_ = SGFLoadStats();
+        recovery_ = SGFRecovery();
+        SGFStatsTimer timer(&stats_, SGFLoadStats::TOTAL);
+        size_t num_nodes = 0;
+        SGFParser parser(input_stream, allocator, 0, inputLength(input_stream), progress_callback_);
+        parser.setProgressInterval(progress_interval_);
+        parser.setStats(&stats_);
+        if (recovery_mode_) {
+            parser.setRecovery(&recovery_);
+        }
+        parser.setNodeCloseCallback([&](BaseSGFNode* closed) {
+            NodeType* node = static_cast<NodeType*>(closed);
+            NodeType* parent = static_cast<NodeType*>(node->parent_);
+            finishNode(node); // all children were added when they were closed
+            if (parent != nullptr) {
+                addChildSize(parent, node);
+            }
+            sink(static_cast<const NodeType&>(*node), static_cast<const NodeType*>(parent));
+            node->detach(); // earlier siblings are already gone, so this is the first child
+            allocator.deallocate(node);
+            ++num_nodes;
+        });
+        while (parser.nextNode());
+        return num_nodes;
+    }
+
+    // property bytes and sibling chains of a loaded tree, see SGFLoadStats
+    void collectTreeStats(const NodeType* root)
+    {
+        if constexpr (SGFLoadStats::enabled) {
+            std::vector<const BaseTreeNode*> stack;
+            if (root != nullptr) {
+                stack.push_back(root);
+            }
+            while (!stack.empty()) {
+                const NodeType* node = static_cast<const NodeType*>(stack.back());
+                stack.pop_back();
+                size_t num_children = 0;
+                for (const BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+                    stack.push_back(child);
+                    ++num_children;
+                }
+                stats_.max_sibling_chain = std::max(stats_.max_sibling_chain, num_children);
+                if constexpr (std::is_base_of_v<SGFTreeNode, NodeType>) {
+                    stats_.property_bytes_retained += node->source_size_;
+                    for (const auto& [tag, values] : node->properties_) {
+                        stats_.property_bytes_retained += tag.size();
+                        for (const std::string& value : values) { stats_.property_bytes_retained += value.size(); }
+                    }
+                }
+            }
+        }
+    }
+
+    // The sizes are accumulated in the nodes themselves: start, add every finished child, then finish.
+    // proof_tree_size_ of an OR node stays 0 until a solved child is seen, solved nodes are always >= 1.
+    static void startNode(NodeType* node)
+    {
+        node->tree_size_ = 0;
+        node->proof_tree_size_ = 0;
+    }
+
+    static void addChildSize(NodeType* node, const NodeType* child)
+    {
+        node->tree_size_ += child->tree_size_;
+        if (!child->solved_) {
             return;
         }
-        size_t tree_size = 1;
         // assume the tree already has correct AND/OR structure (TODO: handle match_tt = true issue)
-        size_t proof_tree_size = node->type_ == NodeType::Type::AND ? 0 : std::numeric_limits<size_t>::max();
-        for (auto child = node->child_; child != nullptr; child = child->next_sibling_) {
-            NodeType* child_node = static_cast<NodeType*>(child);
-            dfsTreeSize(child_node);
-            tree_size += child_node->tree_size_;
-            if (node->type_ == NodeType::Type::AND && child_node->solved_) { // sum for AND node
-                // assert(node->solved_ == false || child_node->solved_); // assertion failed if match_tt = true
-                proof_tree_size += child_node->proof_tree_size_;
-            } else if (node->type_ == NodeType::Type::OR && child_node->solved_) { // min for OR node
-                proof_tree_size = std::min(proof_tree_size, child_node->proof_tree_size_);
-            }
-        }
-        node->tree_size_ = tree_size;
-        // assert(node->solved_ == false || proof_tree_size != std::numeric_limits<size_t>::max()); // assertion failed if match_tt = true
-        if (!(node->solved_ == false || proof_tree_size != std::numeric_limits<size_t>::max())) { // hotfix for match_tt = true
-            assert(node->solved_ == true);
-            node->proof_tree_size_ = 1;
-        } else {
-            node->proof_tree_size_ = node->solved_ ? proof_tree_size + 1 : 0;
+        if (node->type_ == NodeType::Type::AND) { // sum for AND node
+            // assert(node->solved_ == false || child->solved_); // assertion failed if match_tt = true
+            node->proof_tree_size_ += child->proof_tree_size_;
+        } else if (node->type_ == NodeType::Type::OR) { // min for OR node
+            node->proof_tree_size_ = node->proof_tree_size_ == 0 ? child->proof_tree_size_ : std::min(node->proof_tree_size_, child->proof_tree_size_);
         }
     }
+
+    static void finishNode(NodeType* node)
+    {
+        node->tree_size_ += 1;
+        // a solved OR node without solved children counts as 1 (hotfix for match_tt = true)
+        node->proof_tree_size_ = node->solved_ ? node->proof_tree_size_ + 1 : 0;
+    }
+
+    std::shared_ptr<const SGFPropertyPolicy> property_policy_;
+    std::function<void(size_t, size_t)> progress_callback_;
+    SGFProgressInterval progress_interval_;
+    bool transposition_aware_ = false;
+    size_t size_threads_ = 1;
+    std::shared_ptr<typename TreeType::node_pool_type> node_pool_;
+    bool recovery_mode_ = false;
+    SGFRecovery recovery_;
+    SGFLoadStats stats_;
 };
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "sgf_tree_loader.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Merge solver runs of the same root into one tree.
+ *
+ * Children are matched by their move, i.e. the color and packed coordinates
+ * of their B/W property (SGFTreeNode::move_). Matching nodes are combined
+ * into the existing node, and subtrees that only exist in the merged run are
+ * moved over without copying. The sizes are recomputed once at the end.
+ *
+ * @tparam NodeType The node type, SGFTreeNode or a subclass of it.
+ * @tparam TreeType The tree that owns the nodes, e.g. Tree<NodeType> or ArenaTree<NodeType>.
+ */
+template <typename NodeType, typename TreeType = Tree<NodeType>>
+class SGFTreeMerger {
+public:
+    /**
+     * @brief Merge the tree `from` into `into`. Both roots must be the same position.
+     *
+     * A node is solved if it is solved in either run. If both runs solved it,
+     * match_tt_ and pruned_by_rzone_ are only kept when both runs set them,
+     * otherwise they are taken from the run that solved it. Properties of
+     * combined nodes are those of `into`. `from` is left empty.
+     *
+     * @return size_t The number of nodes of `from` that were combined with an existing node.
+     */
+    static size_t merge(TreeType& into, TreeType&& from)
+    {
+        NodeType* from_root = from.getRootNode();
+        NodeType* into_root = into.getRootNode();
+        into.adopt(std::move(from));
+        if (into_root == nullptr) {
+            into.setRootNode(from_root);
+            return 0;
+        }
+        if (from_root == nullptr) {
+            return 0;
+        }
+
+        size_t num_combined = 0;
+        std::vector<std::pair<NodeType*, NodeType*>> stack; // (existing node, node to merge into it)
+        std::vector<std::pair<uint32_t, NodeType*>> index; // children of the existing node, sorted by move
+        stack.emplace_back(into_root, from_root);
+        while (!stack.empty()) {
+            auto [node, other] = stack.back();
+            stack.pop_back();
+            combine(*node, *other);
+            ++num_combined;
+
+            index.clear();
+            for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+                index.emplace_back(moveKey(static_cast<NodeType*>(child)), static_cast<NodeType*>(child));
+            }
+            std::sort(index.begin(), index.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            while (other->child_ != nullptr) {
+                NodeType* child = static_cast<NodeType*>(other->child_->detach()); // the first child, O(1)
+                uint32_t key = moveKey(child);
+                auto it = std::lower_bound(index.begin(), index.end(), key, [](const auto& entry, uint32_t k) { return entry.first < k; });
+                if (it != index.end() && it->first == key) {
+                    stack.emplace_back(it->second, child);
+                } else {
+                    node->addChild(child);
+                    index.insert(it, {key, child});
+                }
+            }
+            into.deleteNode(other);
+        }
+        SGFTreeLoader<NodeType, TreeType>::dfsTreeSize(into_root); // ids of moved subtrees need not be ordered
+        return num_combined;
+    }
+
+private:
+    static uint32_t moveKey(const NodeType* node)
+    {
+        return static_cast<uint32_t>(static_cast<uint8_t>(node->type_)) << 16 | node->move_;
+    }
+
+    static void combine(NodeType& node, const NodeType& other)
+    {
+        if (!other.solved_) {
+            return;
+        }
+        if (!node.solved_) {
+            node.solved_ = true;
+            node.match_tt_ = other.match_tt_;
+            node.pruned_by_rzone_ = other.pruned_by_rzone_;
+        } else {
+            node.match_tt_ = node.match_tt_ && other.match_tt_;
+            node.pruned_by_rzone_ = node.pruned_by_rzone_ && other.pruned_by_rzone_;
+        }
+    }
+};
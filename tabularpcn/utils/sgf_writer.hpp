@@ -0,0 +1,218 @@
+#pragma once
+
+#include "../tree/tree.hpp"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief Iterative SGF writer for annotated SGFTreeNode trees.
+ *
+ * Produces the same text as SGFTreeNode::toSgf, with the sizes and flags
+ * appended to every `C` property, but walks the tree with an explicit stack
+ * and streams the output in chunks of `chunk_size` bytes to a file
+ * descriptor, or appends it to a string.
+ */
+class SGFWriter {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+public:
+    explicit SGFWriter(int fd, size_t chunk_size = DEFAULT_CHUNK_SIZE)
+        : fd_(fd), chunk_size_(chunk_size)
+    {
+        buffer_.reserve(chunk_size_);
+    }
+
+    explicit SGFWriter(std::string& output)
+        : output_(&output) {}
+
+    // copy
+    SGFWriter(const SGFWriter&) = delete;
+    SGFWriter& operator=(const SGFWriter&) = delete;
+
+    ~SGFWriter()
+    {
+        try {
+            flush();
+        } catch (...) {
+            // call flush() explicitly to see write errors
+        }
+    }
+
+    /**
+     * @brief Write the game tree rooted at `root`.
+     */
+    template <typename NodeType>
+    void write(const NodeType* root)
+    {
+        // a node to write, or a literal when node is nullptr
+        struct Item {
+            const NodeType* node;
+            const char* text;
+        };
+        std::vector<Item> stack;
+        stack.push_back({root, nullptr});
+        append("(");
+        while (!stack.empty()) {
+            Item item = stack.back();
+            stack.pop_back();
+            if (item.node == nullptr) {
+                append(item.text);
+                continue;
+            }
+
+            // a node with siblings is wrapped in its own variation, and so is the last sibling
+            const NodeType* node = item.node;
+            const NodeType* child = static_cast<const NodeType*>(node->child_);
+            const NodeType* sibling = static_cast<const NodeType*>(node->next_sibling_);
+            if (sibling != nullptr) {
+                append("(");
+                writeNode(*node);
+                if (sibling->next_sibling_ != nullptr) {
+                    stack.push_back({sibling, nullptr});
+                    stack.push_back({nullptr, ")"});
+                } else {
+                    stack.push_back({nullptr, ")"});
+                    stack.push_back({sibling, nullptr});
+                    stack.push_back({nullptr, ")("});
+                }
+            } else {
+                writeNode(*node);
+            }
+            if (child != nullptr) {
+                stack.push_back({child, nullptr});
+            }
+        }
+        append(")");
+    }
+
+    /**
+     * @brief Write a single node (";" followed by its properties), without its children.
+     */
+    template <typename NodeType>
+    void writeNode(const NodeType& node)
+    {
+        append(";");
+        node.forEachProperty([&](std::string_view tag, const std::vector<std::string_view>& values) {
+            append(tag);
+            if (tag != "C") {
+                for (std::string_view value : values) {
+                    append("[");
+                    append(value);
+                    append("]");
+                }
+                return;
+            }
+            append("[");
+            append(values[0]);
+            append("\nid = ");
+            appendNumber(node.id_);
+            append("\ntype = ");
+            append(typeName(node.type_));
+            append("\ntree_size = ");
+            appendNumber(node.tree_size_);
+            append("\nproof_tree_size = ");
+            appendNumber(node.proof_tree_size_);
+            append("\nsolved = ");
+            append(node.solved_ ? "true" : "false");
+            append("\nmatch_tt = ");
+            append(node.match_tt_ ? "true" : "false");
+            append("\npruned_by_rzone = ");
+            append(node.pruned_by_rzone_ ? "true" : "false");
+            append("]");
+        });
+    }
+
+    /**
+     * @brief Write the buffered output to the file descriptor.
+     */
+    void flush()
+    {
+        writeAll(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+
+    /**
+     * @brief Write the game tree rooted at `root` to a file.
+     */
+    template <typename NodeType>
+    static void writeFile(const NodeType* root, const std::string& path, size_t chunk_size = DEFAULT_CHUNK_SIZE)
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::invalid_argument("Cannot open file: " + path);
+        }
+        try {
+            SGFWriter writer(fd, chunk_size);
+            writer.write(root);
+            writer.flush();
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (::close(fd) != 0) {
+            throw std::runtime_error("Cannot write file: " + path);
+        }
+    }
+
+private:
+    void writeAll(const char* p, size_t remaining)
+    {
+        while (remaining > 0) {
+            ssize_t written = ::write(fd_, p, remaining);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("Cannot write SGF: ") + std::strerror(errno));
+            }
+            p += written;
+            remaining -= written;
+        }
+    }
+
+    void append(std::string_view text)
+    {
+        if (output_ != nullptr) {
+            output_->append(text);
+            return;
+        }
+        if (buffer_.size() + text.size() > chunk_size_) {
+            flush();
+            if (text.size() > chunk_size_) { // too large to buffer, e.g. a huge comment
+                writeAll(text.data(), text.size());
+                return;
+            }
+        }
+        buffer_.insert(buffer_.end(), text.begin(), text.end());
+    }
+
+    template <typename Integer>
+    void appendNumber(Integer value)
+    {
+        char digits[24];
+        char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+        append(std::string_view(digits, end - digits));
+    }
+
+    static const char* typeName(TreeNode::Type type)
+    {
+        switch (type) {
+            case TreeNode::Type::AND: return "AND";
+            case TreeNode::Type::OR: return "OR";
+            default: return "NONE";
+        }
+    }
+
+    int fd_ = -1;
+    size_t chunk_size_ = 0;
+    std::vector<char> buffer_;
+    std::string* output_ = nullptr;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "../tree/compact_tree.hpp"
+#include "sgf_position_hash.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Export a tree as a columnar training table, one NumPy .npy file per column.
+ *
+ * Every row is a node, in preorder. The columns are
+ *   - position_key (uint64): Zobrist key of the position, see SGFPositionHash,
+ *   - parent (uint32): row of the parent, 0xffffffff for the root,
+ *   - type (int8): TreeNode::Type, -1 NONE, 0 AND, 1 OR,
+ *   - solved (uint8),
+ *   - tree_size, proof_tree_size (uint32),
+ *   - log_tree_size, log_proof_tree_size (float32): log1p of the sizes.
+ * The files can be opened with numpy.load(path, mmap_mode="r").
+ */
+class TrainingTableExporter {
+public:
+    using Index = CompactTree::Index;
+
+    /**
+     * @brief Write the table of the subtree rooted at `root` into `directory`, created if needed.
+     *
+     * The sizes must already be computed and fit in the uint32 columns, or
+     * std::length_error is thrown (see CompactTree::build). With `dedup`,
+     * only one row is kept per position: the one with the largest subtree,
+     * the first in preorder on ties. `parent` then refers to the row kept for
+     * the parent's position.
+     *
+     * @param num_threads Number of threads writing columns, 0 for one per hardware thread.
+     * @return size_t The number of rows.
+     */
+    template <typename NodeType>
+    static size_t write(const NodeType* root, const std::string& directory, size_t num_threads = 0, bool dedup = false)
+    {
+        std::vector<uint16_t> moves;
+        CompactTree tree = CompactTree::build(root, [&moves](Index, const NodeType& node) { moves.push_back(node.move_); });
+
+        // parents come before their children in preorder
+        std::vector<uint64_t> keys(tree.size());
+        std::vector<SGFPositionHash::Path> paths(tree.size());
+        for (Index i = 0; i < tree.size(); ++i) {
+            SGFPositionHash::Path parent_path = tree.parent_[i] == CompactTree::NONE ? SGFPositionHash::Path() : paths[tree.parent_[i]];
+            paths[i] = parent_path.extend(tree.type_[i], moves[i]);
+            keys[i] = SGFPositionHash::positionKey(paths[i].hash, tree.type_[i]);
+        }
+
+        // the rows to write and the row of every node's parent
+        std::vector<Index> rows;
+        std::vector<Index> parents;
+        if (!dedup) {
+            rows.resize(tree.size());
+            for (Index i = 0; i < tree.size(); ++i) { rows[i] = i; }
+            parents = tree.parent_;
+        } else {
+            std::unordered_map<uint64_t, Index> kept; // position key -> node
+            for (Index i = 0; i < tree.size(); ++i) {
+                auto [it, inserted] = kept.emplace(keys[i], i);
+                if (!inserted && tree.tree_size_[i] > tree.tree_size_[it->second]) {
+                    it->second = i;
+                }
+            }
+            std::vector<Index> row_of(tree.size(), CompactTree::NONE);
+            for (Index i = 0; i < tree.size(); ++i) {
+                if (kept[keys[i]] == i) {
+                    row_of[i] = static_cast<Index>(rows.size());
+                    rows.push_back(i);
+                }
+            }
+            parents.reserve(rows.size());
+            for (Index i : rows) {
+                Index parent = tree.parent_[i];
+                parents.push_back(parent == CompactTree::NONE ? CompactTree::NONE : row_of[kept[keys[parent]]]);
+            }
+        }
+
+        if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::invalid_argument("Cannot create directory: " + directory);
+        }
+        auto gather = [&rows](const auto& column) {
+            std::vector<typename std::decay_t<decltype(column)>::value_type> values(rows.size());
+            for (size_t r = 0; r < rows.size(); ++r) { values[r] = column[rows[r]]; }
+            return values;
+        };
+        auto log1p = [&rows](const std::vector<Index>& column) {
+            std::vector<float> values(rows.size());
+            for (size_t r = 0; r < rows.size(); ++r) { values[r] = static_cast<float>(std::log1p(static_cast<double>(column[rows[r]]))); }
+            return values;
+        };
+        std::string prefix = directory + "/";
+        std::vector<std::function<void()>> columns = {
+            [&]() { writeNpy(prefix + "position_key.npy", gather(keys)); },
+            [&]() { writeNpy(prefix + "parent.npy", parents); },
+            [&]() { writeNpy(prefix + "type.npy", gather(tree.type_)); },
+            [&]() { writeNpy(prefix + "solved.npy", gather(tree.solved_)); },
+            [&]() { writeNpy(prefix + "tree_size.npy", gather(tree.tree_size_)); },
+            [&]() { writeNpy(prefix + "proof_tree_size.npy", gather(tree.proof_tree_size_)); },
+            [&]() { writeNpy(prefix + "log_tree_size.npy", log1p(tree.tree_size_)); },
+            [&]() { writeNpy(prefix + "log_proof_tree_size.npy", log1p(tree.proof_tree_size_)); },
+        };
+        runParallel(columns, num_threads);
+        return rows.size();
+    }
+
+    /**
+     * @brief Write a one-dimensional array as a .npy file (format version 1.0).
+     */
+    template <typename T>
+    static void writeNpy(const std::string& path, const std::vector<T>& values)
+    {
+        std::string header = "{'descr': '" + std::string(descr<T>()) + "', 'fortran_order': False, 'shape': (" + std::to_string(values.size()) + ",), }";
+        size_t length = 10 + header.size() + 1; // magic, version and header length, then the header ending in '\n'
+        header.append((64 - length % 64) % 64, ' ');
+        header += '\n';
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::invalid_argument("Cannot open file: " + path);
+        }
+        const char magic[8] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+        uint16_t header_size = static_cast<uint16_t>(header.size());
+        const char header_size_bytes[2] = {static_cast<char>(header_size & 0xff), static_cast<char>(header_size >> 8)};
+        file.write(magic, sizeof(magic));
+        file.write(header_size_bytes, sizeof(header_size_bytes));
+        file.write(header.data(), header.size());
+        file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        if (!file) {
+            throw std::runtime_error("Cannot write file: " + path);
+        }
+    }
+
+private:
+    template <typename T>
+    static const char* descr()
+    {
+        constexpr bool little = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+        if constexpr (std::is_same_v<T, uint8_t>) {
+            return "|u1";
+        } else if constexpr (std::is_same_v<T, int8_t> || std::is_same_v<T, TreeNode::Type>) {
+            return "|i1";
+        } else if constexpr (std::is_same_v<T, uint32_t>) {
+            return little ? "<u4" : ">u4";
+        } else if constexpr (std::is_same_v<T, uint64_t>) {
+            return little ? "<u8" : ">u8";
+        } else {
+            static_assert(std::is_same_v<T, float>, "unsupported column type");
+            return little ? "<f4" : ">f4";
+        }
+    }
+
+    static void runParallel(const std::vector<std::function<void()>>& tasks, size_t num_threads)
+    {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        num_threads = std::min(num_threads, tasks.size());
+        std::vector<std::exception_ptr> errors(tasks.size());
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (size_t k = next++; k < tasks.size(); k = next++) {
+                try {
+                    tasks[k]();
+                } catch (...) {
+                    errors[k] = std::current_exception();
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < num_threads; ++t) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+};
@@ -0,0 +1,493 @@
+#pragma once
+
+#include "../tree/compact_tree.hpp"
+#include "sgf_lexer.hpp"
+#include "sgf_tree_loader.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief Binary snapshot of a loaded SGF tree that is read in place from a memory-mapped file.
+ *
+ * Nodes are stored in preorder as fixed-width arrays (see CompactTree), with
+ * links as node indexes. Property text lives in a separate string pool, and
+ * every string is an (offset, size) reference into it. Opening a snapshot
+ * checks every link and reference against the mapped size in one pass over
+ * the arrays, so accessors never read outside the mapping; nothing is parsed
+ * or copied.
+ *
+ * The format holds no pointers, so one mapping can be read by many worker
+ * processes at once, each at its own address: either a file mapped by
+ * open(), whose pages are shared through the page cache, or the shared
+ * memory of share() for workers forked afterwards. Every accessor is const
+ * and only reads the mapping, so threads and processes need no locks.
+ */
+class TreeSnapshot {
+public:
+    using Index = CompactTree::Index;
+    static constexpr Index NONE = CompactTree::NONE;
+
+    enum Flag : uint8_t {
+        SOLVED = 1 << 0,
+        MATCH_TT = 1 << 1,
+        PRUNED_BY_RZONE = 1 << 2,
+    };
+
+    struct StringRef {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+private:
+    enum Section {
+        PARENT,
+        FIRST_CHILD,
+        NEXT_SIBLING,
+        NODE_ID,
+        TREE_SIZE,
+        PROOF_TREE_SIZE,
+        TYPE,
+        FLAGS,
+        NODE_PROPERTY_BEGIN,    // num_nodes + 1 entries
+        PROPERTY_TAG,           // num_properties entries
+        PROPERTY_VALUE_BEGIN,   // num_properties + 1 entries
+        VALUE,                  // num_values entries
+        POOL,                   // pool_size bytes
+        NUM_SECTIONS,
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order; // ENDIAN_MARK as written by the producing machine
+        uint64_t num_nodes;
+        uint64_t num_properties;
+        uint64_t num_values;
+        uint64_t pool_size;
+        uint64_t offsets[NUM_SECTIONS];
+    };
+
+    static constexpr char MAGIC[8] = {'T', 'P', 'C', 'N', 'S', 'N', 'A', 'P'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t ENDIAN_MARK = 0x01020304;
+    static constexpr uint64_t ALIGNMENT = 64;
+
+public:
+    TreeSnapshot() = default;
+
+    /**
+     * @brief Map a snapshot file written by write().
+     */
+    static TreeSnapshot open(const std::string& path)
+    {
+        auto file = std::make_shared<MappedFileInputStream>(path);
+        if (file->size() > 0) {
+            ::madvise(const_cast<char*>(file->data()), file->size(), MADV_NORMAL); // reads jump around, keep the pages cached
+        }
+        TreeSnapshot snapshot(file->data(), file->size());
+        snapshot.storage_ = std::move(file);
+        return snapshot;
+    }
+
+    /**
+     * @brief Write the subtree rooted at `root` as a snapshot file.
+     *
+     * NodeType must provide the SGFTreeNode fields and forEachProperty.
+     */
+    template <typename NodeType>
+    static void write(const NodeType* root, const std::string& path)
+    {
+        FileOutput output(path);
+        serialize(root, output);
+        output.close();
+    }
+
+    /**
+     * @brief Write the subtree rooted at `root` as a snapshot in anonymous shared memory.
+     *
+     * The memory is read-only once written. Processes forked afterwards
+     * inherit the mapping, so N workers read one copy of the tree instead of
+     * loading N. Workers that are not forked from this process should open()
+     * a file written by write() instead, e.g. under /dev/shm to keep it in RAM.
+     */
+    template <typename NodeType>
+    static TreeSnapshot share(const NodeType* root)
+    {
+        SharedOutput output;
+        serialize(root, output);
+        if (::mprotect(output.data_, output.size_, PROT_READ) != 0) {
+            throw std::runtime_error("Cannot protect shared tree snapshot");
+        }
+        TreeSnapshot snapshot(output.data_, output.size_);
+        snapshot.storage_ = std::move(output.storage_);
+        return snapshot;
+    }
+
+    /**
+     * @brief Rebuild a node tree from the snapshot.
+     *
+     * Node ids are restored, except for trees that index nodes by their own ids (ArenaTree).
+     */
+    template <typename NodeType, typename TreeType = Tree<NodeType>>
+    TreeType toTree() const
+    {
+        TreeType tree;
+        std::vector<NodeType*> nodes(size());
+        for (Index i = 0; i < size(); ++i) {
+            NodeType* node = tree.createNode();
+            if constexpr (!IsIndexedTree<TreeType>::value) {
+                node->id_ = nodeId(i);
+            }
+            node->type_ = type(i);
+            node->solved_ = solved(i);
+            node->match_tt_ = matchTT(i);
+            node->pruned_by_rzone_ = prunedByRzone(i);
+            node->tree_size_ = treeSize(i);
+            node->proof_tree_size_ = proofTreeSize(i);
+            for (uint64_t p = propertyBegin(i); p < propertyEnd(i); ++p) {
+                std::vector<std::string> property_values;
+                for (uint64_t v = valueBegin(p); v < valueEnd(p); ++v) {
+                    property_values.emplace_back(value(v));
+                }
+                node->properties_.emplace_back(std::string(tag(p)), std::move(property_values));
+            }
+            if (parent(i) != NONE) {
+                nodes[parent(i)]->addChild(node); // preorder keeps the siblings in order
+            }
+            nodes[i] = node;
+        }
+        if (!nodes.empty()) {
+            tree.setRootNode(nodes[0]);
+        }
+        return tree;
+    }
+
+    Index size() const { return header_ ? static_cast<Index>(header_->num_nodes) : 0; }
+    bool empty() const { return size() == 0; }
+
+    // per-node fields, indexed in preorder
+    Index parent(Index i) const { return array<Index>(PARENT)[i]; }
+    Index firstChild(Index i) const { return array<Index>(FIRST_CHILD)[i]; }
+    Index nextSibling(Index i) const { return array<Index>(NEXT_SIBLING)[i]; }
+    uint64_t nodeId(Index i) const { return array<uint64_t>(NODE_ID)[i]; }
+    uint64_t treeSize(Index i) const { return array<uint64_t>(TREE_SIZE)[i]; }
+    uint64_t proofTreeSize(Index i) const { return array<uint64_t>(PROOF_TREE_SIZE)[i]; }
+    TreeNode::Type type(Index i) const { return array<TreeNode::Type>(TYPE)[i]; }
+    uint8_t flags(Index i) const { return array<uint8_t>(FLAGS)[i]; }
+    bool solved(Index i) const { return flags(i) & SOLVED; }
+    bool matchTT(Index i) const { return flags(i) & MATCH_TT; }
+    bool prunedByRzone(Index i) const { return flags(i) & PRUNED_BY_RZONE; }
+
+    // properties of node i are [propertyBegin(i), propertyEnd(i)), values of property p are [valueBegin(p), valueEnd(p))
+    uint64_t propertyBegin(Index i) const { return array<uint64_t>(NODE_PROPERTY_BEGIN)[i]; }
+    uint64_t propertyEnd(Index i) const { return array<uint64_t>(NODE_PROPERTY_BEGIN)[i + 1]; }
+    std::string_view tag(uint64_t p) const { return string(array<StringRef>(PROPERTY_TAG)[p]); }
+    uint64_t valueBegin(uint64_t p) const { return array<uint64_t>(PROPERTY_VALUE_BEGIN)[p]; }
+    uint64_t valueEnd(uint64_t p) const { return array<uint64_t>(PROPERTY_VALUE_BEGIN)[p + 1]; }
+    std::string_view value(uint64_t v) const { return string(array<StringRef>(VALUE)[v]); }
+
+    // whole columns, for scans
+    const Index* parents() const { return array<Index>(PARENT); }
+    const uint64_t* treeSizes() const { return array<uint64_t>(TREE_SIZE); }
+    const uint64_t* proofTreeSizes() const { return array<uint64_t>(PROOF_TREE_SIZE); }
+    const TreeNode::Type* types() const { return array<TreeNode::Type>(TYPE); }
+    const uint8_t* flags() const { return array<uint8_t>(FLAGS); }
+
+private:
+    TreeSnapshot(const char* data, size_t size)
+        : data_(data)
+    {
+        if (size < sizeof(Header)) {
+            throw std::runtime_error("Invalid tree snapshot: file too small");
+        }
+        const Header* header = reinterpret_cast<const Header*>(data);
+        if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::runtime_error("Invalid tree snapshot: bad magic");
+        }
+        if (header->version != VERSION) {
+            throw std::runtime_error("Invalid tree snapshot: unsupported version " + std::to_string(header->version));
+        }
+        if (header->byte_order != ENDIAN_MARK) {
+            throw std::runtime_error("Invalid tree snapshot: written with a different byte order");
+        }
+        validateCounts(*header, size);
+        for (int section = 0; section < NUM_SECTIONS; ++section) {
+            uint64_t offset = header->offsets[section];
+            if (offset % ALIGNMENT != 0 || offset > size || sectionSize(*header, static_cast<Section>(section)) > size - offset) {
+                throw std::runtime_error("Invalid tree snapshot: section out of bounds");
+            }
+        }
+        header_ = header;
+        validate();
+    }
+
+    // every count is checked against the size first (an entry takes at least one byte), so sectionSize cannot overflow
+    static void validateCounts(const Header& header, size_t size)
+    {
+        if (header.num_nodes >= NONE || header.num_nodes > size || header.num_properties > size || header.num_values > size || header.pool_size > size) {
+            throw std::runtime_error("Invalid tree snapshot: counts out of bounds");
+        }
+    }
+
+    // links point forward in preorder except to the parent, ranges are sorted and end at the next section's count
+    void validate() const
+    {
+        const Index num_nodes = size();
+        for (Index i = 0; i < num_nodes; ++i) {
+            if ((parent(i) != NONE && parent(i) >= i) || (firstChild(i) != NONE && (firstChild(i) <= i || firstChild(i) >= num_nodes)) || (nextSibling(i) != NONE && (nextSibling(i) <= i || nextSibling(i) >= num_nodes))) {
+                throw std::runtime_error("Invalid tree snapshot: node " + std::to_string(i) + " links out of bounds");
+            }
+        }
+        validateRanges(array<uint64_t>(NODE_PROPERTY_BEGIN), header_->num_nodes, header_->num_properties);
+        validateRanges(array<uint64_t>(PROPERTY_VALUE_BEGIN), header_->num_properties, header_->num_values);
+        validateStrings(array<StringRef>(PROPERTY_TAG), header_->num_properties);
+        validateStrings(array<StringRef>(VALUE), header_->num_values);
+    }
+
+    static void validateRanges(const uint64_t* begin, uint64_t num_ranges, uint64_t num_entries)
+    {
+        if (begin[0] != 0 || begin[num_ranges] != num_entries) {
+            throw std::runtime_error("Invalid tree snapshot: ranges out of bounds");
+        }
+        for (uint64_t r = 0; r < num_ranges; ++r) {
+            if (begin[r] > begin[r + 1]) {
+                throw std::runtime_error("Invalid tree snapshot: ranges out of order");
+            }
+        }
+    }
+
+    void validateStrings(const StringRef* refs, uint64_t num_refs) const
+    {
+        for (uint64_t k = 0; k < num_refs; ++k) {
+            if (refs[k].offset > header_->pool_size || refs[k].size > header_->pool_size - refs[k].offset) {
+                throw std::runtime_error("Invalid tree snapshot: string out of bounds");
+            }
+        }
+    }
+
+    // snapshot output to a file, preallocated so that a full disk fails before the tree is written
+    struct FileOutput {
+        explicit FileOutput(const std::string& path)
+            : path_(path), fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644))
+        {
+            if (fd_ < 0) {
+                throw std::invalid_argument("Cannot open file: " + path);
+            }
+        }
+
+        // copy
+        FileOutput(const FileOutput&) = delete;
+        FileOutput& operator=(const FileOutput&) = delete;
+
+        ~FileOutput()
+        {
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+        }
+
+        void reserve(uint64_t size)
+        {
+            int error = ::posix_fallocate(fd_, 0, static_cast<off_t>(size));
+            if (error != 0 && error != EOPNOTSUPP) { // some file systems cannot preallocate, the writes still work
+                throw std::runtime_error("Cannot reserve " + std::to_string(size) + " bytes for file: " + path_);
+            }
+        }
+
+        void write(const char* data, uint64_t size)
+        {
+            while (size > 0) {
+                ssize_t written = ::write(fd_, data, size);
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    throw std::runtime_error("Cannot write file: " + path_);
+                }
+                data += written;
+                size -= static_cast<uint64_t>(written);
+                position_ += static_cast<uint64_t>(written);
+            }
+        }
+
+        uint64_t position() { return position_; }
+
+        void close()
+        {
+            int fd = fd_;
+            fd_ = -1;
+            if (::close(fd) != 0) {
+                throw std::runtime_error("Cannot write file: " + path_);
+            }
+        }
+
+        std::string path_;
+        int fd_;
+        uint64_t position_ = 0;
+    };
+
+    // snapshot output to an anonymous shared mapping of the final size
+    struct SharedOutput {
+        void reserve(uint64_t size)
+        {
+            void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (addr == MAP_FAILED) {
+                throw std::runtime_error("Cannot map " + std::to_string(size) + " bytes of shared memory");
+            }
+            data_ = static_cast<char*>(addr);
+            size_ = size;
+            storage_ = std::shared_ptr<const void>(addr, [size](const void* mapping) { ::munmap(const_cast<void*>(mapping), size); });
+        }
+
+        void write(const char* data, uint64_t size)
+        {
+            std::memcpy(data_ + position_, data, size);
+            position_ += size;
+        }
+
+        uint64_t position() { return position_; }
+
+        char* data_ = nullptr;
+        uint64_t size_ = 0;
+        uint64_t position_ = 0;
+        std::shared_ptr<const void> storage_;
+    };
+
+    template <typename NodeType, typename Output>
+    static void serialize(const NodeType* root, Output& output)
+    {
+        std::vector<const NodeType*> nodes;
+        CompactTree topology = CompactTree::buildStructure(root, [&nodes](Index, const NodeType& node) { nodes.push_back(&node); });
+
+        // string references first, the pool itself is written from the nodes at the end
+        std::vector<uint64_t> node_property_begin = {0};
+        std::vector<StringRef> property_tags;
+        std::vector<uint64_t> property_value_begin = {0};
+        std::vector<StringRef> values;
+        uint64_t pool_size = 0;
+        auto addString = [&pool_size](std::string_view str) -> StringRef {
+            StringRef ref = {pool_size, str.size()};
+            pool_size += str.size();
+            return ref;
+        };
+        std::vector<uint64_t> tree_sizes, proof_tree_sizes;
+        std::vector<uint8_t> flags;
+        tree_sizes.reserve(nodes.size());
+        proof_tree_sizes.reserve(nodes.size());
+        flags.reserve(nodes.size());
+        for (const NodeType* node : nodes) {
+            node->forEachProperty([&](std::string_view tag, const std::vector<std::string_view>& property_values) {
+                property_tags.push_back(addString(tag));
+                for (std::string_view value : property_values) {
+                    values.push_back(addString(value));
+                }
+                property_value_begin.push_back(values.size());
+            });
+            node_property_begin.push_back(property_tags.size());
+            tree_sizes.push_back(node->tree_size_);
+            proof_tree_sizes.push_back(node->proof_tree_size_);
+            flags.push_back((node->solved_ ? SOLVED : 0) | (node->match_tt_ ? MATCH_TT : 0) | (node->pruned_by_rzone_ ? PRUNED_BY_RZONE : 0));
+        }
+
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.byte_order = ENDIAN_MARK;
+        header.num_nodes = nodes.size();
+        header.num_properties = property_tags.size();
+        header.num_values = values.size();
+        header.pool_size = pool_size;
+        uint64_t offset = align(sizeof(Header));
+        for (int section = 0; section < NUM_SECTIONS; ++section) {
+            header.offsets[section] = offset;
+            offset = align(offset + sectionSize(header, static_cast<Section>(section)));
+        }
+
+        output.reserve(header.offsets[POOL] + header.pool_size);
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeSection(output, header, PARENT, topology.parent_);
+        writeSection(output, header, FIRST_CHILD, topology.first_child_);
+        writeSection(output, header, NEXT_SIBLING, topology.next_sibling_);
+        writeSection(output, header, NODE_ID, std::vector<uint64_t>(topology.node_id_.begin(), topology.node_id_.end()));
+        writeSection(output, header, TREE_SIZE, tree_sizes);
+        writeSection(output, header, PROOF_TREE_SIZE, proof_tree_sizes);
+        writeSection(output, header, TYPE, topology.type_);
+        writeSection(output, header, FLAGS, flags);
+        writeSection(output, header, NODE_PROPERTY_BEGIN, node_property_begin);
+        writeSection(output, header, PROPERTY_TAG, property_tags);
+        writeSection(output, header, PROPERTY_VALUE_BEGIN, property_value_begin);
+        writeSection(output, header, VALUE, values);
+        pad(output, header.offsets[POOL]);
+        for (const NodeType* node : nodes) {
+            node->forEachProperty([&output](std::string_view tag, const std::vector<std::string_view>& property_values) {
+                output.write(tag.data(), tag.size());
+                for (std::string_view value : property_values) {
+                    output.write(value.data(), value.size());
+                }
+            });
+        }
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    static uint64_t sectionSize(const Header& header, Section section)
+    {
+        switch (section) {
+            case PARENT:
+            case FIRST_CHILD:
+            case NEXT_SIBLING: return header.num_nodes * sizeof(Index);
+            case NODE_ID:
+            case TREE_SIZE:
+            case PROOF_TREE_SIZE: return header.num_nodes * sizeof(uint64_t);
+            case TYPE: return header.num_nodes * sizeof(TreeNode::Type);
+            case FLAGS: return header.num_nodes * sizeof(uint8_t);
+            case NODE_PROPERTY_BEGIN: return (header.num_nodes + 1) * sizeof(uint64_t);
+            case PROPERTY_TAG: return header.num_properties * sizeof(StringRef);
+            case PROPERTY_VALUE_BEGIN: return (header.num_properties + 1) * sizeof(uint64_t);
+            case VALUE: return header.num_values * sizeof(StringRef);
+            case POOL: return header.pool_size;
+            default: return 0;
+        }
+    }
+
+    template <typename Output>
+    static void pad(Output& output, uint64_t offset)
+    {
+        static const char zeros[ALIGNMENT] = {};
+        output.write(zeros, offset - output.position());
+    }
+
+    template <typename Output, typename T>
+    static void writeSection(Output& output, const Header& header, Section section, const std::vector<T>& data)
+    {
+        pad(output, header.offsets[section]);
+        output.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T));
+    }
+
+    template <typename T>
+    const T* array(Section section) const
+    {
+        return reinterpret_cast<const T*>(data_ + header_->offsets[section]);
+    }
+
+    std::string_view string(const StringRef& ref) const
+    {
+        return std::string_view(data_ + header_->offsets[POOL] + ref.offset, ref.size);
+    }
+
+    const char* data_ = nullptr;
+    const Header* header_ = nullptr;
+    std::shared_ptr<const void> storage_; // keeps the mapping alive, shared by copies
+};
@@ -0,0 +1,38 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/tree/compact_tree.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include "tabularpcn/utils/training_table.hpp"
+#include <gtest/gtest.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+TEST(CompactTreeTest, SizesMatchTheLoadedTree)
+{
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(SGFGenerator(2).mixed(500));
+    CompactTree compact = CompactTree::build(tree.getRootNode());
+    ASSERT_EQ(compact.size(), tree.getTreeSize());
+    EXPECT_EQ(compact.tree_size_[0], tree.getRootNode()->tree_size_);
+    EXPECT_EQ(compact.proof_tree_size_[0], tree.getRootNode()->proof_tree_size_);
+
+    CompactTree recomputed = compact;
+    SGFTreeLoader<SGFTreeNode>::dfsTreeSize(recomputed);
+    EXPECT_EQ(recomputed.tree_size_, compact.tree_size_);
+    EXPECT_EQ(recomputed.proof_tree_size_, compact.proof_tree_size_);
+}
+
+TEST(CompactTreeTest, SizesAbove32BitsThrow)
+{
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa];W[bb])");
+    SGFTreeNode* root = tree.getRootNode();
+    root->tree_size_ = size_t(std::numeric_limits<CompactTree::Index>::max()) + 1;
+    EXPECT_THROW(CompactTree::build(root), std::length_error);
+    EXPECT_THROW(TrainingTableExporter::write(root, ::testing::TempDir() + "tabularpcn_table_overflow"), std::length_error);
+
+    root->tree_size_ = 2;
+    root->proof_tree_size_ = size_t(std::numeric_limits<CompactTree::Index>::max()) + 1;
+    EXPECT_THROW(CompactTree::build(root), std::length_error);
+
+    root->proof_tree_size_ = std::numeric_limits<CompactTree::Index>::max();
+    EXPECT_EQ(CompactTree::build(root).proof_tree_size_[0], std::numeric_limits<CompactTree::Index>::max());
+}
@@ -0,0 +1,177 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/utils/compressed_input_stream.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include "test_trees.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+#if defined(TABULARPCN_USE_ZLIB)
+std::string gzipString(const std::string& data)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) { // 16: write a gzip header
+        throw std::runtime_error("Cannot initialize zlib");
+    }
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int ret = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        throw std::runtime_error("Cannot compress");
+    }
+    return out;
+}
+#endif
+
+#if defined(TABULARPCN_USE_ZSTD)
+std::string zstdString(const std::string& data)
+{
+    std::string out(ZSTD_compressBound(data.size()), '\0');
+    size_t size = ZSTD_compress(&out[0], out.size(), data.data(), data.size(), 3);
+    if (ZSTD_isError(size)) {
+        throw std::runtime_error(ZSTD_getErrorName(size));
+    }
+    out.resize(size);
+    return out;
+}
+#endif
+
+class CompressedFileInputStreamTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        path_ = ::testing::TempDir() + "tabularpcn_compressed_" + std::to_string(::getpid());
+        sgf_ = SGFGenerator(9).mixed(2000);
+    }
+
+    void TearDown() override
+    {
+        std::remove(path_.c_str());
+    }
+
+    void writeFile(const std::string& data) const
+    {
+        std::ofstream(path_, std::ios::binary) << data;
+    }
+
+    // every byte of the stream; the bytes read before an error are in `out`
+    static void readStream(const std::string& path, size_t block_size, std::string& out)
+    {
+        CompressedFileInputStream input(path, block_size);
+        for (char c = input.get(); c != '\0'; c = input.get()) {
+            out += c;
+        }
+    }
+
+    // the file read through the stream, with unget() at every block boundary, and loaded by every file load
+    void expectReadsBack(const std::string& expected, Compression compression) const
+    {
+        EXPECT_EQ(CompressedFileInputStream::detect(path_), compression);
+        EXPECT_EQ(CompressedFileInputStream::readAll(path_), expected);
+        for (size_t block_size : {size_t(1), size_t(7), size_t(4096), CompressedFileInputStream::DEFAULT_BLOCK_SIZE}) {
+            CompressedFileInputStream input(path_, block_size);
+            std::string out;
+            for (char c = input.get(); c != '\0'; c = input.get()) {
+                out += c;
+                EXPECT_EQ(input.tellg(), out.size());
+                input.unget();
+                ASSERT_EQ(input.get(), c) << "block size " << block_size << ", offset " << out.size();
+                ASSERT_EQ(input.peek(), expected.c_str()[out.size()]);
+            }
+            EXPECT_EQ(out, expected) << "block size " << block_size;
+        }
+
+        std::string dump = dumpTree(SGFTreeLoader<SGFTreeNode>().loadFromString(expected).getRootNode());
+        EXPECT_EQ(dumpTree(SGFTreeLoader<SGFTreeNode>().loadFromFile(path_).getRootNode()), dump);
+        EXPECT_EQ(dumpTree(SGFTreeLoader<SGFTreeNode, ArenaTree<SGFTreeNode>>().loadParallelFromFile(path_, 4).getRootNode()), dump);
+        EXPECT_EQ(SGFTreeLoader<SGFTreeNode>().loadStreamingFromFile(path_, [](const SGFTreeNode&, const SGFTreeNode*) {}), countNodes(expected));
+    }
+
+    // a truncated file gives a prefix of the input, then an error
+    void expectTruncationError(const std::string& compressed) const
+    {
+        writeFile(compressed.substr(0, compressed.size() / 2));
+        std::string out;
+        EXPECT_THROW(readStream(path_, 4096, out), SGFTruncatedError);
+        EXPECT_FALSE(out.empty());
+        EXPECT_LT(out.size(), sgf_.size());
+        EXPECT_EQ(sgf_.compare(0, out.size(), out), 0);
+        EXPECT_THROW(CompressedFileInputStream::readAll(path_), SGFTruncatedError);
+        EXPECT_THROW(SGFTreeLoader<SGFTreeNode>().loadFromFile(path_), SGFTruncatedError);
+
+        // recovery keeps the nodes of the decompressed prefix
+        SGFTreeLoader<SGFTreeNode> loader;
+        loader.setRecoveryMode(true);
+        std::string expected = dumpTree(loader.loadFromString(out).getRootNode());
+        EXPECT_EQ(dumpTree(loader.loadFromFile(path_).getRootNode()), expected);
+        EXPECT_TRUE(loader.getRecovery().recovered);
+        EXPECT_EQ(loader.getRecovery().error.rfind("Truncated", 0), 0u) << loader.getRecovery().error;
+        EXPECT_GT(loader.getRecovery().error_start, 0u); // after the last complete token
+        EXPECT_LE(loader.getRecovery().error_start, out.size());
+    }
+
+    std::string path_;
+    std::string sgf_;
+};
+
+} // namespace
+
+TEST_F(CompressedFileInputStreamTest, UncompressedFilesReadBack)
+{
+    writeFile(sgf_);
+    expectReadsBack(sgf_, Compression::NONE);
+    writeFile("");
+    EXPECT_EQ(CompressedFileInputStream::readAll(path_), "");
+    EXPECT_THROW(CompressedFileInputStream(path_ + ".missing"), std::invalid_argument);
+}
+
+TEST_F(CompressedFileInputStreamTest, GzipFilesReadBack)
+{
+#if defined(TABULARPCN_USE_ZLIB)
+    writeFile(gzipString(sgf_));
+    expectReadsBack(sgf_, Compression::GZIP);
+    // concatenated members, as written by appending to a .gz file
+    writeFile(gzipString(sgf_.substr(0, 5000)) + gzipString(sgf_.substr(5000)));
+    EXPECT_EQ(CompressedFileInputStream::readAll(path_), sgf_);
+#else
+    GTEST_SKIP() << "built without TABULARPCN_USE_ZLIB";
+#endif
+}
+
+TEST_F(CompressedFileInputStreamTest, ZstdFilesReadBack)
+{
+#if defined(TABULARPCN_USE_ZSTD)
+    writeFile(zstdString(sgf_));
+    expectReadsBack(sgf_, Compression::ZSTD);
+    writeFile(zstdString(sgf_.substr(0, 5000)) + zstdString(sgf_.substr(5000)));
+    EXPECT_EQ(CompressedFileInputStream::readAll(path_), sgf_);
+#else
+    GTEST_SKIP() << "built without TABULARPCN_USE_ZSTD";
+#endif
+}
+
+TEST_F(CompressedFileInputStreamTest, TruncatedStreamsGivePartialDataThenError)
+{
+#if defined(TABULARPCN_USE_ZLIB)
+    expectTruncationError(gzipString(sgf_));
+#endif
+#if defined(TABULARPCN_USE_ZSTD)
+    expectTruncationError(zstdString(sgf_));
+#endif
+#if !defined(TABULARPCN_USE_ZLIB) && !defined(TABULARPCN_USE_ZSTD)
+    GTEST_SKIP() << "built without a codec";
+#endif
+}
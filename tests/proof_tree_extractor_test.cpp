@@ -0,0 +1,151 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/tree/proof_tree_extractor.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Index = ProofTreeExtractor::Index;
+
+namespace {
+
+const std::string WIN = "C[solver_status: WIN\nmatch_tt = false\nequal_loss = 0]";
+
+std::vector<Index> bestChildren(const ProofTreeExtractor& extractor, const CompactTree& tree)
+{
+    std::vector<Index> best;
+    for (Index i = 0; i < tree.size(); ++i) {
+        best.push_back(extractor.bestChild(i));
+    }
+    return best;
+}
+
+// the solved node with the largest proof, so that the proof has OR and AND nodes
+SGFTreeNode* largestProof(SGFTreeNode* root)
+{
+    SGFTreeNode* best = nullptr;
+    std::vector<SGFTreeNode*> stack = {root};
+    while (!stack.empty()) {
+        SGFTreeNode* node = stack.back();
+        stack.pop_back();
+        if (node->solved_ && (best == nullptr || node->proof_tree_size_ > best->proof_tree_size_)) {
+            best = node;
+        }
+        for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+            stack.push_back(static_cast<SGFTreeNode*>(child));
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+TEST(ProofTreeExtractorTest, ParallelEvaluationMatchesSweep)
+{
+    SGFGenerator generator(8);
+    for (const std::string& sgf : {generator.mixed(4000), generator.wideOrRoot(30, 40), generator.transpositionHeavy(6, 4)}) {
+        auto loaded = SGFTreeLoader<SGFTreeNode>().loadFromString(sgf);
+        CompactTree expected = CompactTree::build(loaded.getRootNode());
+        ProofTreeExtractor sweep;
+        sweep.evaluate(expected);
+        EXPECT_EQ(expected.tree_size_[0], loaded.getRootNode()->tree_size_);
+        EXPECT_EQ(expected.proof_tree_size_[0], loaded.getRootNode()->proof_tree_size_);
+
+        for (size_t num_threads : {2, 4}) {
+            for (Index threshold : {1, 7, 64, 1000}) {
+                CompactTree tree = CompactTree::build(loaded.getRootNode());
+                ProofTreeExtractor parallel(num_threads, threshold);
+                parallel.evaluate(tree);
+                EXPECT_EQ(tree.tree_size_, expected.tree_size_) << num_threads << " threads, threshold " << threshold;
+                EXPECT_EQ(tree.proof_tree_size_, expected.proof_tree_size_) << num_threads << " threads, threshold " << threshold;
+                EXPECT_EQ(bestChildren(parallel, tree), bestChildren(sweep, expected)) << num_threads << " threads, threshold " << threshold;
+            }
+        }
+    }
+}
+
+TEST(ProofTreeExtractorTest, TiesGoToTheFirstChild)
+{
+    // the root (B, OR) has three solved children with proofs of 2, 2 and 1 nodes, then 2 again
+    std::string sgf = "(;B[aa]" + WIN + "(;W[bb]" + WIN + ";B[cc]" + WIN + ")(;W[dd]" + WIN + ";B[ee]" + WIN + ")(;W[ff]" + WIN + ")(;W[gg]" + WIN + ";B[hh]" + WIN + "))";
+    std::string tied = "(;B[aa]" + WIN + "(;W[bb]" + WIN + ";B[cc]" + WIN + ")(;W[dd]" + WIN + ";B[ee]" + WIN + ")(;W[gg]" + WIN + ";B[hh]" + WIN + "))";
+    auto loaded = SGFTreeLoader<SGFTreeNode>().loadFromString(sgf);
+    auto loaded_tied = SGFTreeLoader<SGFTreeNode>().loadFromString(tied);
+    for (size_t num_threads : {1, 2}) {
+        // with a threshold of 1 the root is finished after the tasks, in document order
+        for (Index threshold : {Index(1), ProofTreeExtractor::DEFAULT_PARALLEL_THRESHOLD}) {
+            ProofTreeExtractor extractor(num_threads, threshold);
+            CompactTree tree = CompactTree::build(loaded.getRootNode());
+            extractor.evaluate(tree);
+            EXPECT_EQ(extractor.bestChild(0), 5u); // W[ff]
+            EXPECT_EQ(tree.proof_tree_size_[0], 2u);
+
+            tree = CompactTree::build(loaded_tied.getRootNode());
+            extractor.evaluate(tree);
+            EXPECT_EQ(extractor.bestChild(0), 1u); // W[bb], not W[dd] or W[gg]
+            EXPECT_EQ(tree.proof_tree_size_[0], 3u);
+        }
+    }
+}
+
+TEST(ProofTreeExtractorTest, ExtractedProofIsMaterialized)
+{
+    auto loaded = SGFTreeLoader<SGFTreeNode>().loadFromString(SGFGenerator(12).mixed(3000));
+    SGFTreeNode* root = largestProof(loaded.getRootNode());
+    ASSERT_NE(root, nullptr);
+    ASSERT_GT(root->proof_tree_size_, 3u);
+
+    ProofTreeExtractor extractor(2, 16);
+    std::vector<const SGFTreeNode*> proof = extractor.extract(static_cast<const SGFTreeNode*>(root));
+    ASSERT_EQ(proof.size(), root->proof_tree_size_);
+    ASSERT_EQ(proof[0], root);
+
+    Tree<SGFTreeNode> materialized = ProofTreeExtractor::materialize(loaded, proof);
+    ASSERT_EQ(materialized.getTreeSize(), proof.size());
+    EXPECT_EQ(materialized.getRootNode()->tree_size_, proof.size());
+    EXPECT_EQ(materialized.getRootNode()->proof_tree_size_, proof.size());
+
+    // walk the copies in preorder, which is the order of the proof, and check every parent
+    std::unordered_map<const BaseTreeNode*, const BaseTreeNode*> original_of;
+    std::vector<const SGFTreeNode*> copies;
+    std::vector<const SGFTreeNode*> stack = {materialized.getRootNode()};
+    while (!stack.empty()) {
+        const SGFTreeNode* copy = stack.back();
+        stack.pop_back();
+        ASSERT_LT(copies.size(), proof.size());
+        const SGFTreeNode* original = proof[copies.size()];
+        original_of[copy] = original;
+        copies.push_back(copy);
+        EXPECT_EQ(copy->move_, original->move_);
+        EXPECT_EQ(copy->properties_, original->properties_);
+        if (copy->parent_ == nullptr) {
+            EXPECT_EQ(copy, materialized.getRootNode());
+        } else {
+            EXPECT_EQ(original_of.at(copy->parent_), original->parent_);
+        }
+        std::vector<const SGFTreeNode*> children;
+        for (const BaseTreeNode* child = copy->child_; child != nullptr; child = child->next_sibling_) {
+            children.push_back(static_cast<const SGFTreeNode*>(child));
+        }
+        stack.insert(stack.end(), children.rbegin(), children.rend());
+    }
+    EXPECT_EQ(copies.size(), proof.size());
+}
+
+TEST(ProofTreeExtractorTest, ExtractIgnoresStaleSizes)
+{
+    auto loaded = SGFTreeLoader<SGFTreeNode>().loadFromString(SGFGenerator(13).mixed(500));
+    SGFTreeNode* root = largestProof(loaded.getRootNode());
+    ASSERT_NE(root, nullptr);
+    std::vector<const SGFTreeNode*> expected = ProofTreeExtractor().extract(static_cast<const SGFTreeNode*>(root));
+    ASSERT_FALSE(expected.empty());
+
+    root->tree_size_ = size_t(1) << 40; // would not fit in a CompactTree
+    root->proof_tree_size_ = 0;
+    if (root->child_ != nullptr) {
+        static_cast<SGFTreeNode*>(root->child_)->proof_tree_size_ = size_t(1) << 33;
+    }
+    EXPECT_EQ(ProofTreeExtractor().extract(static_cast<const SGFTreeNode*>(root)), expected);
+    EXPECT_THROW(CompactTree::build(root), std::length_error);
+}
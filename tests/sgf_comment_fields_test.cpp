@@ -0,0 +1,131 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/utils/sgf_comment_fields.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Fields {
+    std::map<std::string, std::string> values;
+};
+
+// the lookup SGFTreeNode used before SGFCommentFields: the first occurrence anywhere, up to the end of the line
+std::string findValue(const std::string& comment, const std::string& key)
+{
+    size_t pos = comment.find(key);
+    if (pos == std::string::npos) {
+        return "<missing>";
+    }
+    pos += key.size();
+    size_t end_pos = comment.find('\n', pos);
+    if (end_pos == std::string::npos) {
+        end_pos = comment.size();
+    } else if (end_pos > 0 && comment[end_pos - 1] == '\r') {
+        --end_pos;
+    }
+    return comment.substr(pos, end_pos - pos);
+}
+
+const std::vector<std::string> KEYS = {"solver_status: ", "match_tt = ", "equal_loss = ", "nodes = ", "note: ", "no"};
+
+void expectSameAsFind(const std::string& comment)
+{
+    SGFCommentFields<Fields> fields;
+    for (const std::string& key : KEYS) {
+        fields.add(key, [key](Fields& node, std::string_view value) { node.values[key] = std::string(value); });
+    }
+    Fields node;
+    fields.extract(node, comment);
+    for (const std::string& key : KEYS) {
+        auto it = node.values.find(key);
+        EXPECT_EQ(it == node.values.end() ? "<missing>" : it->second, findValue(comment, key)) << "key \"" << key << "\" in \"" << comment << '"';
+    }
+}
+
+// the C values of an SGF text
+std::vector<std::string> comments(const std::string& sgf)
+{
+    std::vector<std::string> result;
+    for (size_t pos = sgf.find("C["); pos != std::string::npos; pos = sgf.find("C[", pos)) {
+        size_t end = sgf.find(']', pos);
+        result.push_back(sgf.substr(pos + 2, end - pos - 2));
+        pos = end;
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(SGFCommentFieldsTest, SolverCommentsMatchFind)
+{
+    SGFGenerator generator(11);
+    for (const std::string& comment : comments(generator.mixed(500))) {
+        expectSameAsFind(comment);
+    }
+    for (const std::string& comment : comments(generator.transpositionHeavy(5, 3))) {
+        expectSameAsFind(comment);
+    }
+}
+
+TEST(SGFCommentFieldsTest, KeysAnywhereMatchFind)
+{
+    const std::vector<std::string> inputs = {
+        "",
+        "solver_status: WIN",
+        "proof done, solver_status: WIN\nmatch_tt = false",
+        "  match_tt = true\r\nequal_loss = -1\r\n",
+        "note: match_tt = true\nmatch_tt = false",
+        "solver_status: \nsolver_status: LOSS",
+        "equal_loss = 3\r",
+        "nodes = 12nodes = 13\n",
+        "nono",
+        "n",
+    };
+    for (const std::string& comment : inputs) {
+        expectSameAsFind(comment);
+    }
+}
+
+TEST(SGFCommentFieldsTest, TreeNodeReadsStatusAfterOtherText)
+{
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa]C[search done, solver_status: WIN\nmatch_tt = false\nequal_loss = -1])");
+    EXPECT_TRUE(tree.getRootNode()->solved_);
+    EXPECT_FALSE(tree.getRootNode()->match_tt_);
+    EXPECT_FALSE(tree.getRootNode()->pruned_by_rzone_);
+}
+
+TEST(SGFCommentFieldsTest, InterleavedAndRepeatedKeysUseFirstOccurrence)
+{
+    const std::vector<std::string> inputs = {
+        "match_tt = 1 nodes = 2 match_tt = 3 nodes = 4\nmatch_tt = 5",
+        "nodes = no\nno nodes = 7\nnodes = 8",      // "no" inside "nodes = " and on its own
+        "note: nonodes = 1 note: 2",                // keys sharing first bytes, overlapping matches
+        "equal_loss = equal_loss = -1\r\nequal_loss = 2",
+        "solver_status: match_tt = x\nmatch_tt = y\nsolver_status: z",
+        "nnnnodes = 3\nnonote: 4",
+    };
+    for (const std::string& comment : inputs) {
+        expectSameAsFind(comment);
+    }
+
+    SGFCommentFields<Fields> fields;
+    std::vector<std::string> order;
+    for (const std::string& key : {"nodes = ", "match_tt = ", "no"}) {
+        fields.add(key, [key, &order](Fields&, std::string_view value) { order.push_back(key + std::string(value)); });
+    }
+    Fields node;
+    fields.extract(node, "no match_tt = 1 nodes = 2");
+    EXPECT_EQ(order, (std::vector<std::string>{"nodes = 2", "match_tt = 1 nodes = 2", "no match_tt = 1 nodes = 2"})); // registration order
+}
+
+TEST(SGFCommentFieldsTest, RejectsTooManyFields)
+{
+    SGFCommentFields<Fields> fields;
+    for (size_t k = 0; k < SGFCommentFields<Fields>::MAX_FIELDS; ++k) {
+        fields.add("key" + std::to_string(k) + "=", [](Fields&, std::string_view) {});
+    }
+    EXPECT_THROW(fields.add("one more=", [](Fields&, std::string_view) {}), std::invalid_argument);
+}
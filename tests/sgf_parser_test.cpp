@@ -0,0 +1,129 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/utils/sgf_parser.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+size_t parse(const std::string& sgf, TrackingNodeAllocator<SGFTreeNode>& allocator)
+{
+    StringInputStream input(sgf);
+    SGFParser parser(input, allocator);
+    while (parser.nextNode());
+    return allocator.getAllocatedNodes().size();
+}
+
+// fails with a std::runtime_error after `limit` nodes, which is not an error of the input
+class LimitedNodeAllocator : public TrackingNodeAllocator<SGFTreeNode> {
+public:
+    explicit LimitedNodeAllocator(size_t limit) : limit_(limit) {}
+
+    BaseSGFNode* allocate() override
+    {
+        if (getAllocatedNodes().size() == limit_) {
+            throw std::runtime_error("Node limit reached");
+        }
+        return TrackingNodeAllocator<SGFTreeNode>::allocate();
+    }
+
+private:
+    size_t limit_;
+};
+
+} // namespace
+
+TEST(TrackingNodeAllocatorTest, DeallocatesInAnyOrder)
+{
+    std::string sgf = SGFGenerator(4).mixed(2000);
+    TrackingNodeAllocator<SGFTreeNode> allocator;
+    size_t num_nodes = parse(sgf, allocator);
+    ASSERT_GT(num_nodes, 1000u);
+
+    std::vector<SGFTreeNode*> nodes(allocator.getAllocatedNodes().begin(), allocator.getAllocatedNodes().end());
+    std::sort(nodes.begin(), nodes.end()); // neither allocation order nor its reverse
+    for (size_t i = 0; i < nodes.size(); i += 2) {
+        allocator.deallocate(nodes[i]);
+    }
+    EXPECT_EQ(allocator.getAllocatedNodes().size(), num_nodes / 2);
+    allocator.deallocate(nodes[0]); // already freed, ignored
+    EXPECT_EQ(allocator.getAllocatedNodes().size(), num_nodes / 2);
+    for (size_t i = 1; i < nodes.size(); i += 2) {
+        EXPECT_EQ(allocator.getAllocatedNodes().count(nodes[i]), 1u);
+        allocator.deallocate(nodes[i]);
+    }
+    EXPECT_TRUE(allocator.getAllocatedNodes().empty());
+
+    // the freed nodes are recycled by the next parse
+    EXPECT_EQ(parse(sgf, allocator), num_nodes);
+    allocator.deallocateAll();
+    EXPECT_TRUE(allocator.getAllocatedNodes().empty());
+    EXPECT_EQ(parse(sgf, allocator), num_nodes);
+}
+
+TEST(TrackingNodeAllocatorTest, ForwardDeallocationIsNotQuadratic)
+{
+    std::string sgf = SGFGenerator(4).wideOrRoot(200, 500);
+    TrackingNodeAllocator<SGFTreeNode> allocator;
+    StringInputStream input(sgf);
+    SGFParser parser(input, allocator);
+    std::vector<BaseSGFNode*> nodes;
+    while (BaseSGFNode* node = parser.nextNode()) {
+        nodes.push_back(node);
+    }
+    ASSERT_GT(nodes.size(), 50000u);
+    auto start = std::chrono::steady_clock::now();
+    for (BaseSGFNode* node : nodes) {
+        allocator.deallocate(node);
+    }
+    // a linear search per node takes seconds here
+    EXPECT_LT(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1.0);
+}
+
+TEST(SGFErrorTest, KeepsPositionsPast32Bits)
+{
+    size_t start = size_t(3) << 32;
+    SGFError error("Unexpected token", start, start + 1);
+    EXPECT_TRUE(error.hasPosition());
+    EXPECT_EQ(error.start_, start);
+    EXPECT_EQ(error.end_, start + 1);
+    EXPECT_EQ(std::string(error.what()), "Unexpected token at " + std::to_string(start) + ":" + std::to_string(start + 1));
+}
+
+TEST(SGFErrorTest, ReportsMissingPosition)
+{
+    LexicalError error("Unexpected end of file", BaseSGFException::npos, BaseSGFException::npos);
+    EXPECT_FALSE(error.hasPosition());
+    EXPECT_EQ(std::string(error.what()), "Unexpected end of file");
+}
+
+TEST(SGFErrorTest, TruncationHasNoPosition)
+{
+    SGFTruncatedError error("Truncated gzip input");
+    EXPECT_FALSE(error.hasPosition());
+    EXPECT_EQ(std::string(error.what()), "Truncated gzip input");
+}
+
+TEST(SGFParserTest, RecoveryOnlyStopsAtInputErrors)
+{
+    std::string sgf = "(;B[aa](;W[bb];B[cc])(;W[dd]))";
+    SGFRecovery recovery;
+    LimitedNodeAllocator allocator(3);
+    StringInputStream input(sgf);
+    SGFParser parser(input, allocator);
+    parser.setRecovery(&recovery);
+    EXPECT_THROW(while (parser.nextNode()), std::runtime_error);
+    EXPECT_FALSE(recovery.recovered);
+
+    StringInputStream truncated(sgf.substr(0, 16));
+    LimitedNodeAllocator unlimited(100);
+    SGFParser truncated_parser(truncated, unlimited);
+    truncated_parser.setRecovery(&recovery);
+    while (truncated_parser.nextNode());
+    EXPECT_TRUE(recovery.recovered);
+    EXPECT_EQ(unlimited.getAllocatedNodes().size(), 3u);
+}
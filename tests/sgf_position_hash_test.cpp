@@ -0,0 +1,116 @@
+#include "tabularpcn/utils/sgf_position_hash.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// position key after the moves, given as "B aa" / "W " (pass)
+uint64_t positionKey(const std::vector<std::pair<char, std::string>>& moves)
+{
+    SGFPositionHash::Path path;
+    TreeNode::Type type = TreeNode::Type::NONE;
+    for (const auto& [color, move] : moves) {
+        type = color == 'B' ? TreeNode::Type::OR : TreeNode::Type::AND;
+        path = path.extend(type, SGFTreeNode::packMove(move));
+    }
+    return SGFPositionHash::positionKey(path.hash, type);
+}
+
+// the node reached from the root by taking the given child at every depth
+SGFTreeNode* descend(SGFTreeNode* node, const std::vector<int>& children)
+{
+    for (int child : children) {
+        BaseTreeNode* next = node->child_;
+        for (int k = 0; k < child; ++k) {
+            next = next->next_sibling_;
+        }
+        node = static_cast<SGFTreeNode*>(next);
+    }
+    return node;
+}
+
+const std::string WIN = "C[solver_status: WIN\nmatch_tt = false\nequal_loss = 0]";
+const std::string HIT = "C[solver_status: WIN\nmatch_tt = true\nequal_loss = 0]";
+
+} // namespace
+
+TEST(SGFPositionHashTest, TranspositionsHashEqual)
+{
+    EXPECT_EQ(positionKey({{'B', "aa"}, {'W', "bb"}, {'B', "cc"}}), positionKey({{'B', "cc"}, {'W', "bb"}, {'B', "aa"}}));
+    EXPECT_EQ(positionKey({{'B', ""}, {'W', "bb"}, {'B', "cc"}}), positionKey({{'B', "cc"}, {'W', "bb"}, {'B', ""}}));
+    EXPECT_EQ(positionKey({{'B', ""}, {'W', ""}, {'B', "cc"}, {'W', "dd"}, {'B', ""}}), positionKey({{'B', "cc"}, {'W', ""}, {'B', ""}, {'W', "dd"}, {'B', ""}}));
+}
+
+TEST(SGFPositionHashTest, RepeatedPassesDoNotCancel)
+{
+    EXPECT_NE(positionKey({{'B', "aa"}, {'W', ""}, {'B', ""}, {'W', ""}, {'B', ""}}), positionKey({{'B', "aa"}}));
+    EXPECT_NE(positionKey({{'B', ""}, {'W', "bb"}, {'B', ""}, {'W', "cc"}}), positionKey({{'W', "bb"}, {'W', "cc"}}));
+    EXPECT_NE(positionKey({{'B', ""}, {'W', ""}, {'B', ""}, {'W', ""}}), positionKey({{'B', ""}, {'W', ""}}));
+}
+
+TEST(SGFPositionHashTest, RepeatedMovesDoNotCancel)
+{
+    // a recapture repeats a move of the same player
+    EXPECT_NE(positionKey({{'B', "aa"}, {'W', "bb"}, {'B', "aa"}, {'W', "cc"}}), positionKey({{'B', "dd"}, {'W', "bb"}, {'B', "dd"}, {'W', "cc"}}));
+    EXPECT_NE(positionKey({{'B', "aa"}, {'W', "bb"}, {'B', "aa"}, {'W', "cc"}}), positionKey({{'W', "bb"}, {'W', "cc"}}));
+    EXPECT_EQ(positionKey({{'B', "aa"}, {'W', "bb"}, {'B', "aa"}, {'W', "cc"}}), positionKey({{'B', "aa"}, {'W', "cc"}, {'B', "aa"}, {'W', "bb"}}));
+}
+
+TEST(SGFPositionHashTest, NodesWithoutMoveAreNotPasses)
+{
+    EXPECT_EQ(SGFPositionHash::moveKey(TreeNode::Type::OR, SGFPositionHash::NO_MOVE), 0u);
+    EXPECT_NE(SGFPositionHash::moveKey(TreeNode::Type::OR, SGFPositionHash::PASS), 0u);
+
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString("(;AB[aa];B[];W[bb]C[setup])");
+    SGFTreeNode* root = tree.getRootNode();
+    EXPECT_EQ(root->move_, SGFTreeNode::NO_MOVE);
+    EXPECT_EQ(descend(root, {0})->move_, SGFTreeNode::PASS);
+    EXPECT_EQ(SGFTreeNode::packMove(""), SGFTreeNode::PASS);
+}
+
+TEST(SGFPositionHashTest, MovesOtherThanPassesKeepTheirKeys)
+{
+    SGFPositionHash::Path path = SGFPositionHash::Path().extend(TreeNode::Type::OR, SGFTreeNode::packMove("aa"));
+    EXPECT_EQ(path.hash, SGFPositionHash::moveKey(TreeNode::Type::OR, SGFTreeNode::packMove("aa")));
+    EXPECT_EQ(SGFPositionHash::Path().extend(TreeNode::Type::NONE, SGFPositionHash::PASS).hash, 0u);
+}
+
+TEST(SGFPositionHashTest, TranspositionHitsTakeTheProofOfTheirPosition)
+{
+    // the hit B[aa] of the second variation reaches the position of B[aa] in the first one
+    std::string sgf = "(;C[root](;B[cc];W[bb];B[aa]" + WIN + "(;W[dd]" + WIN + ";B[ee]" + WIN + ")(;W[ff]" + WIN + "))(;B[aa];W[bb];B[cc];W[hh]" + WIN + ")(;B[aa];W[bb];B[cc]" + HIT + "))";
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(sgf);
+    SGFTreeNode* root = tree.getRootNode();
+    SGFTreeLoader<SGFTreeNode>::dfsTreeSize(root);
+    SGFTreeNode* source = descend(root, {0, 0, 0});
+    SGFTreeNode* hit = descend(root, {2, 0, 0});
+    ASSERT_TRUE(hit->match_tt_);
+    size_t hit_proof = hit->proof_tree_size_;
+    size_t root_proof = root->proof_tree_size_;
+    ASSERT_NE(source->proof_tree_size_, hit_proof);
+
+    SGFTreeLoader<SGFTreeNode>::dfsTranspositionTreeSize(root);
+    EXPECT_EQ(hit->proof_tree_size_, source->proof_tree_size_);
+    EXPECT_EQ(descend(root, {1, 0, 0, 0})->proof_tree_size_, 1u); // another position at the same depth
+    EXPECT_EQ(hit->tree_size_, 1u);
+    EXPECT_GE(root->proof_tree_size_, root_proof);
+}
+
+TEST(SGFPositionHashTest, TranspositionHitsIgnoreOtherPositions)
+{
+    // B[aa] and B[dd] are both played twice: with XOR both paths would hash as W[bb] W[cc]
+    std::string sgf = "(;C[root](;B[dd];W[bb];B[dd];W[cc]" + WIN + "(;B[ee]" + WIN + ";W[ff]" + WIN + ")(;B[gg]" + WIN + "))(;B[aa];W[bb];B[aa];W[cc]" + HIT + "))";
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(sgf);
+    SGFTreeNode* root = tree.getRootNode();
+    SGFTreeLoader<SGFTreeNode>::dfsTreeSize(root);
+    SGFTreeNode* hit = descend(root, {1, 0, 0, 0});
+    ASSERT_TRUE(hit->match_tt_);
+    size_t hit_proof = hit->proof_tree_size_;
+    ASSERT_NE(descend(root, {0, 0, 0, 0})->proof_tree_size_, hit_proof);
+
+    SGFTreeLoader<SGFTreeNode>::dfsTranspositionTreeSize(root);
+    EXPECT_EQ(hit->proof_tree_size_, hit_proof);
+}
@@ -0,0 +1,43 @@
+#include "tabularpcn/utils/sgf_scanner.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <string>
+
+// every position of one delimiter in buffers long enough for the vector loops and their scalar tails
+TEST(SGFScannerTest, FindValueDelimiterMatchesScalarSearch)
+{
+    for (char delimiter : {']', '\\', '\0'}) {
+        for (size_t size = 0; size < 80; ++size) {
+            for (size_t position = 0; position <= size; ++position) {
+                std::string buffer(size, 'a');
+                if (position < size) {
+                    buffer[position] = delimiter;
+                }
+                const char* begin = buffer.data();
+                const char* end = begin + size;
+                const char* expected = std::find_if(begin, end, SGFScanner::isValueDelimiter);
+                EXPECT_EQ(SGFScanner::findValueDelimiter(begin, end), expected) << "size " << size << " position " << position;
+            }
+        }
+    }
+}
+
+TEST(SGFScannerTest, SkipWhitespaceMatchesScalarSearch)
+{
+    const std::string whitespace = " \t\n\v\f\r";
+    for (size_t size = 0; size < 80; ++size) {
+        for (size_t position = 0; position <= size; ++position) {
+            std::string buffer;
+            for (size_t i = 0; i < size; ++i) {
+                buffer += whitespace[i % whitespace.size()];
+            }
+            if (position < size) {
+                buffer[position] = ';';
+            }
+            const char* begin = buffer.data();
+            const char* end = begin + size;
+            const char* expected = std::find_if_not(begin, end, SGFScanner::isWhitespace);
+            EXPECT_EQ(SGFScanner::skipWhitespace(begin, end), expected) << "size " << size << " position " << position;
+        }
+    }
+}
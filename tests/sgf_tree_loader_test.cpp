@@ -0,0 +1,306 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/utils/sgf_packed_loader.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include "test_trees.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using TreeLoader = SGFTreeLoader<SGFTreeNode>;
+using ArenaLoader = SGFTreeLoader<SGFTreeNode, ArenaTree<SGFTreeNode>>;
+
+namespace {
+
+std::vector<std::string> generatedInputs()
+{
+    SGFGenerator generator(7);
+    return {
+        generator.wideOrRoot(16, 20),
+        generator.mixed(3000),
+        generator.transpositionHeavy(6, 4),
+        generator.deepLine(200),
+        "(;B[aa](;W[bb])(;W[cc];B[dd](;W[ee])(;W[ff])))",
+    };
+}
+
+// the dump of the tree, or the error message of the load
+template <typename Load>
+std::string loadResult(Load&& load)
+{
+    try {
+        return dumpTree(load().getRootNode());
+    } catch (const std::exception& error) {
+        return std::string("error: ") + error.what();
+    }
+}
+
+// a size that throws when it is added to, to fail one subtree of a size computation
+struct ThrowingSize {
+    ThrowingSize& operator=(size_t size)
+    {
+        value = size;
+        return *this;
+    }
+
+    ThrowingSize& operator+=(size_t size)
+    {
+        if (armed) {
+            throw std::runtime_error("size of an armed node");
+        }
+        value += size;
+        return *this;
+    }
+
+    operator size_t() const { return value; }
+
+    size_t value = 0;
+    bool armed = false;
+};
+
+struct ThrowingNode : SGFTreeNode {
+    ThrowingSize tree_size_;
+};
+
+} // namespace
+
+TEST(SGFTreeLoaderTest, ParallelLoadMatchesSequentialLoad)
+{
+    for (const std::string& sgf : generatedInputs()) {
+        TreeLoader loader;
+        auto expected = loader.loadFromString(sgf);
+        for (size_t num_threads : {1, 2, 4}) {
+            ArenaLoader parallel_loader;
+            auto tree = parallel_loader.loadParallelFromString(sgf, num_threads);
+            EXPECT_EQ(tree.getTreeSize(), expected.getTreeSize());
+            EXPECT_EQ(dumpTree(tree.getRootNode()), dumpTree(expected.getRootNode()));
+        }
+    }
+}
+
+TEST(SGFTreeLoaderTest, ParallelLoadMatchesSequentialLoadOnMalformedInputs)
+{
+    const std::vector<std::string> inputs = {
+        "(;B[aa](;W[bb]);W[cc](;B[dd]))", // nodes between the variations
+        "(;B[aa](;W[bb])(;W[cc]);B[dd])", // nodes after the variations
+        "(;B[aa](;W[bb])C[x](;W[cc]))",
+        "(;B[aa](;W[bb])(;W[cc]))x",
+        "(;B[aa](;W[bb])(;W[cc]))(;B[dd])",
+        "(;B[aa](;W[bb])(;W[cc])",
+        "(;B[aa]x(;W[bb])(;W[cc]))",
+        "(;B[aa](;W[bb]B)(;W[cc]))",
+        "(;B[aa](;W[bb](;B[cc]);W[dd])(;W[ee]))",
+    };
+    for (const std::string& sgf : inputs) {
+        std::string expected = loadResult([&] { return ArenaLoader().loadFromString(sgf); });
+        EXPECT_EQ(expected.rfind("error: ", 0), 0u) << sgf;
+        EXPECT_EQ(loadResult([&] { return ArenaLoader().loadParallelFromString(sgf, 2); }), expected) << sgf;
+    }
+}
+
+TEST(SGFTreeLoaderTest, ArenaAndPooledLoadsMatchTreeLoad)
+{
+    auto pool = std::make_shared<ArenaTree<SGFTreeNode>::node_pool_type>();
+    for (const std::string& sgf : generatedInputs()) {
+        TreeLoader loader;
+        auto expected = loader.loadFromString(sgf);
+        ArenaLoader arena_loader;
+        EXPECT_EQ(dumpTree(arena_loader.loadFromString(sgf).getRootNode()), dumpTree(expected.getRootNode()));
+        arena_loader.setNodePool(pool);
+        for (int repeat = 0; repeat < 2; ++repeat) {
+            EXPECT_EQ(dumpTree(arena_loader.loadFromString(sgf).getRootNode()), dumpTree(expected.getRootNode()));
+        }
+    }
+}
+
+TEST(SGFTreeLoaderTest, PackedLoadMatchesTreeLoad)
+{
+    for (const std::string& sgf : generatedInputs()) {
+        TreeLoader loader;
+        auto expected = loader.loadFromString(sgf);
+        SGFPackedLoader<> packed_loader;
+        auto packed = packed_loader.loadFromString(sgf);
+        ASSERT_EQ(packed.size(), expected.getTreeSize());
+        EXPECT_EQ(packed[0].tree_size_, expected.getRootNode()->tree_size_);
+        EXPECT_EQ(packed[0].proof_tree_size_, expected.getRootNode()->proof_tree_size_);
+    }
+}
+
+TEST(SGFTreeLoaderTest, StrictModeThrowsOnTruncatedInput)
+{
+    TreeLoader loader;
+    EXPECT_THROW(loader.loadFromString("(;B[aa](;W[bb]"), SGFError);
+    EXPECT_THROW(loader.loadFromString("(;B[aa];W[b"), LexicalError);
+    EXPECT_THROW(loader.loadFromString("(;B[aa])x"), SGFError);
+}
+
+TEST(SGFTreeLoaderTest, RecoveryKeepsEveryNodeOfTruncatedPrefixes)
+{
+    std::string sgf = SGFGenerator(3).mixed(800);
+    for (size_t cut = 0; cut < sgf.size(); cut += 97) {
+        std::string prefix = sgf.substr(0, cut);
+        TreeLoader loader;
+        loader.setRecoveryMode(true);
+        auto tree = loader.loadFromString(prefix);
+        size_t expected = countNodes(prefix);
+        ASSERT_EQ(tree.getTreeSize(), expected) << "cut at " << cut;
+        EXPECT_EQ(loader.getRecovery().recovered, cut > 0) << "cut at " << cut;
+        if (expected == 0) {
+            continue;
+        }
+        EXPECT_EQ(tree.getRootNode()->tree_size_, expected);
+        std::string sizes = dumpTree(tree.getRootNode());
+        TreeLoader::dfsTreeSize(tree);
+        EXPECT_EQ(dumpTree(tree.getRootNode()), sizes);
+
+        SGFPackedLoader<> packed_loader;
+        packed_loader.setRecoveryMode(true);
+        auto packed = packed_loader.loadFromString(prefix);
+        ASSERT_EQ(packed.size(), expected);
+        EXPECT_EQ(packed[0].proof_tree_size_, tree.getRootNode()->proof_tree_size_);
+        EXPECT_EQ(loader.loadStreamingFromString(prefix, [](const SGFTreeNode&, const SGFTreeNode*) {}), expected);
+    }
+}
+
+TEST(SGFTreeLoaderTest, RecoveryReportsMalformedInputs)
+{
+    TreeLoader loader;
+    loader.setRecoveryMode(true);
+
+    auto tree = loader.loadFromString("(;B[aa](;W[bb]");
+    EXPECT_EQ(tree.getTreeSize(), 2u);
+    EXPECT_EQ(loader.getRecovery().error, "Unmatched left parentheses");
+    EXPECT_EQ(loader.getRecovery().error_start, 7u);
+    EXPECT_EQ(loader.getRecovery().closed_variations, 2u);
+
+    tree = loader.loadFromString("(;B[aa];W[bb]AB[cc][dd][e");
+    ASSERT_EQ(tree.getTreeSize(), 2u);
+    const SGFTreeNode* white = static_cast<const SGFTreeNode*>(tree.getRootNode()->child_);
+    ASSERT_EQ(white->properties_.size(), 2u);
+    EXPECT_EQ(white->properties_[1].second.size(), 2u); // the values read before the end
+
+    tree = loader.loadFromString("(;B[aa])x");
+    EXPECT_EQ(tree.getTreeSize(), 1u);
+    EXPECT_TRUE(loader.getRecovery().recovered);
+    EXPECT_EQ(loader.getRecovery().closed_variations, 0u);
+
+    tree = loader.loadFromString("(;");
+    ASSERT_NE(tree.getRootNode(), nullptr);
+    EXPECT_EQ(tree.getRootNode()->tree_size_, 1u);
+
+    tree = loader.loadFromString("(;B[aa](;W[bb])(;W[cc]))\n");
+    EXPECT_EQ(tree.getTreeSize(), 3u);
+    EXPECT_FALSE(loader.getRecovery().recovered);
+}
+
+TEST(SGFTreeLoaderTest, ParallelRecoveryMatchesSequentialRecovery)
+{
+    const std::vector<std::string> inputs = {
+        "(;B[aa](;W[bb];B[cc])(;W[dd]x;B[ee]))", // error in a variation
+        "(;B[aa]x(;W[bb])(;W[cc]))",             // error on the main line
+        "(;B[aa](;W[bb])(;W[cc];B[d",            // truncated
+    };
+    for (const std::string& sgf : inputs) {
+        TreeLoader loader;
+        loader.setRecoveryMode(true);
+        auto expected = loader.loadFromString(sgf);
+        SGFRecovery expected_recovery = loader.getRecovery();
+        ASSERT_TRUE(expected_recovery.recovered) << sgf;
+        for (size_t num_threads : {1, 2, 4}) {
+            ArenaLoader parallel_loader;
+            parallel_loader.setRecoveryMode(true);
+            auto tree = parallel_loader.loadParallelFromString(sgf, num_threads);
+            EXPECT_EQ(tree.getTreeSize(), expected.getTreeSize()) << sgf;
+            EXPECT_EQ(dumpTree(tree.getRootNode()), dumpTree(expected.getRootNode())) << sgf;
+            EXPECT_EQ(parallel_loader.getRecovery().toString(), expected_recovery.toString()) << sgf;
+        }
+    }
+}
+
+TEST(SGFTreeLoaderTest, ParallelSizesMatchSequentialSizes)
+{
+    SGFGenerator generator(17);
+    for (const std::string& sgf : {generator.mixed(5000), generator.wideOrRoot(40, 30), generator.deepLine(3000), generator.transpositionHeavy(6, 4), std::string("(;B[aa])")}) {
+        auto tree = TreeLoader().loadFromString(sgf);
+        std::string expected = dumpTree(tree.getRootNode());
+        std::vector<SGFTreeNode*> nodes(tree.getNodes().begin(), tree.getNodes().end());
+        // the split depends on the sizes before the computation: up to date, unknown or stale
+        for (int hints = 0; hints < 3; ++hints) {
+            for (size_t num_threads : {2, 3, 4, 8, 64}) {
+                for (size_t k = 0; k < nodes.size() && hints > 0; ++k) {
+                    nodes[k]->tree_size_ = hints == 1 ? 0 : (k * 7919) % 1000;
+                    nodes[k]->proof_tree_size_ = hints == 1 ? 0 : k % 3;
+                }
+                TreeLoader::dfsTreeSizeParallel(tree, num_threads);
+                ASSERT_EQ(dumpTree(tree.getRootNode()), expected) << num_threads << " threads, hints " << hints;
+            }
+        }
+        ArenaLoader arena_loader;
+        arena_loader.setSizeThreads(4);
+        auto arena = arena_loader.loadFromString(sgf);
+        EXPECT_EQ(dumpTree(arena.getRootNode()), expected);
+    }
+}
+
+TEST(SGFTreeLoaderTest, ParallelSizesRethrowWorkerErrors)
+{
+    // 64 subtrees of 21 nodes, the last leaf of one of them throws
+    Tree<ThrowingNode> tree;
+    ThrowingNode* root = tree.createNode();
+    tree.setRootNode(root);
+    ThrowingNode* armed = nullptr;
+    for (int i = 0; i < 64; ++i) {
+        ThrowingNode* child = tree.createNode();
+        root->addChild(child);
+        for (int j = 0; j < 20; ++j) {
+            ThrowingNode* leaf = tree.createNode();
+            child->addChild(leaf);
+            armed = i == 37 ? leaf : armed;
+        }
+    }
+    SGFTreeLoader<ThrowingNode>::dfsTreeSize(root);
+    ASSERT_EQ(root->tree_size_, 64u * 21 + 1);
+
+    armed->tree_size_.armed = true;
+    for (size_t num_threads : {2, 4, 16}) {
+        try {
+            SGFTreeLoader<ThrowingNode>::dfsTreeSizeParallel(root, num_threads);
+            ADD_FAILURE() << "no error with " << num_threads << " threads";
+        } catch (const std::runtime_error& error) {
+            EXPECT_EQ(std::string(error.what()), "size of an armed node");
+        }
+    }
+    armed->tree_size_.armed = false;
+    SGFTreeLoader<ThrowingNode>::dfsTreeSizeParallel(root, 4);
+    EXPECT_EQ(root->tree_size_, 64u * 21 + 1);
+}
+
+TEST(SGFTreeLoaderTest, ArenaLoadsKeepSlotIds)
+{
+    auto expectIndexed = [](ArenaTree<SGFTreeNode>& tree, const std::string& load) {
+        size_t count = 0;
+        tree.forEachNode([&](SGFTreeNode* node) {
+            ASSERT_EQ(tree.getNode(node->id_), node) << load;
+            ++count;
+        });
+        EXPECT_EQ(count, tree.getTreeSize()) << load;
+    };
+    auto pool = std::make_shared<ArenaTree<SGFTreeNode>::node_pool_type>();
+    for (const std::string& sgf : generatedInputs()) {
+        ArenaLoader loader;
+        auto tree = loader.loadFromString(sgf);
+        expectIndexed(tree, "sequential");
+        tree = loader.loadParallelFromString(sgf, 4);
+        expectIndexed(tree, "parallel");
+        loader.setRecoveryMode(true);
+        tree = loader.loadFromString(sgf.substr(0, sgf.size() / 2));
+        expectIndexed(tree, "recovered");
+        // slabs taken from and given back to a pool between the loads
+        loader.setNodePool(pool);
+        for (int repeat = 0; repeat < 2; ++repeat) {
+            tree = loader.loadFromString(sgf);
+            expectIndexed(tree, "pooled");
+            tree = loader.loadParallelFromString(sgf, 3);
+            expectIndexed(tree, "pooled parallel");
+        }
+    }
+}
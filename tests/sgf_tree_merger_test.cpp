@@ -0,0 +1,74 @@
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include "tabularpcn/utils/sgf_tree_merger.hpp"
+#include "test_trees.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+
+const std::string WIN = "C[solver_status: WIN\nmatch_tt = false\nequal_loss = 0]";
+const std::string HIT = "C[solver_status: WIN\nmatch_tt = true\nequal_loss = 0]";
+
+template <typename TreeType>
+void expectMergeMatches(const std::string& into_sgf, const std::string& from_sgf, const std::string& merged_sgf, size_t num_combined)
+{
+    using Loader = SGFTreeLoader<SGFTreeNode, TreeType>;
+    TreeType into = Loader().loadFromString(into_sgf);
+    TreeType from = Loader().loadFromString(from_sgf);
+    TreeType expected = Loader().loadFromString(merged_sgf);
+    EXPECT_EQ((SGFTreeMerger<SGFTreeNode, TreeType>::merge(into, std::move(from))), num_combined);
+    EXPECT_EQ(from.getTreeSize(), 0u);
+    EXPECT_EQ(into.getTreeSize(), expected.getTreeSize());
+    EXPECT_EQ(dumpTree(into.getRootNode()), dumpTree(expected.getRootNode()));
+}
+
+} // namespace
+
+TEST(SGFTreeMergerTest, SharedPrefixesMergeByMove)
+{
+    // W[bb] is in both runs; B[cc] and B[ee] below it and W[ff] at the root only in one
+    std::string into = "(;B[aa](;W[bb];B[cc]" + WIN + ")(;W[dd]))";
+    std::string from = "(;B[aa](;W[ff];B[gg]" + WIN + ")(;W[bb];B[ee]" + WIN + "))";
+    std::string merged = "(;B[aa](;W[bb](;B[cc]" + WIN + ")(;B[ee]" + WIN + "))(;W[dd])(;W[ff];B[gg]" + WIN + "))";
+    expectMergeMatches<Tree<SGFTreeNode>>(into, from, merged, 2);
+    expectMergeMatches<ArenaTree<SGFTreeNode>>(into, from, merged, 2);
+}
+
+TEST(SGFTreeMergerTest, DisjointChildrenAreAdopted)
+{
+    std::string into = "(;B[aa](;W[bb];B[cc]))";
+    std::string from = "(;B[aa](;W[dd](;B[ee]" + WIN + ")(;B[ff];W[gg]" + WIN + "))(;W[]" + WIN + "))";
+    std::string merged = "(;B[aa](;W[bb];B[cc])(;W[dd](;B[ee]" + WIN + ")(;B[ff];W[gg]" + WIN + "))(;W[]" + WIN + "))";
+    expectMergeMatches<Tree<SGFTreeNode>>(into, from, merged, 1);
+    expectMergeMatches<ArenaTree<SGFTreeNode>>(into, from, merged, 1);
+
+    // a pass and a move of the other color are different children
+    expectMergeMatches<Tree<SGFTreeNode>>("(;B[aa](;W[])(;W[bb]))", "(;B[aa](;B[bb])(;W[]))", "(;B[aa](;W[])(;W[bb])(;B[bb]))", 2);
+}
+
+TEST(SGFTreeMergerTest, SolvedFlagsAreCombined)
+{
+    auto into = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa](;W[bb])(;W[cc]" + HIT + ")(;W[dd]" + HIT + "))");
+    auto from = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa](;W[bb]" + HIT + ")(;W[cc]" + WIN + ")(;W[dd]" + HIT + "))");
+    SGFTreeMerger<SGFTreeNode>::merge(into, std::move(from));
+    SGFTreeNode* bb = static_cast<SGFTreeNode*>(into.getRootNode()->child_);
+    SGFTreeNode* cc = static_cast<SGFTreeNode*>(bb->next_sibling_);
+    SGFTreeNode* dd = static_cast<SGFTreeNode*>(cc->next_sibling_);
+    EXPECT_TRUE(bb->solved_); // only solved in `from`, flags taken from it
+    EXPECT_TRUE(bb->match_tt_);
+    EXPECT_EQ(bb->properties_.size(), 1u); // the properties of `into`
+    EXPECT_TRUE(cc->solved_);
+    EXPECT_FALSE(cc->match_tt_); // solved by both runs, one without a hit
+    EXPECT_TRUE(dd->match_tt_);
+    EXPECT_EQ(into.getRootNode()->tree_size_, 4u);
+}
+
+TEST(SGFTreeMergerTest, EmptyTreesMerge)
+{
+    Tree<SGFTreeNode> into;
+    auto from = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa];W[bb])");
+    EXPECT_EQ(SGFTreeMerger<SGFTreeNode>::merge(into, std::move(from)), 0u);
+    EXPECT_EQ(dumpTree(into.getRootNode()), dumpTree(SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa];W[bb])").getRootNode()));
+    EXPECT_EQ(SGFTreeMerger<SGFTreeNode>::merge(into, Tree<SGFTreeNode>()), 0u);
+    EXPECT_EQ(into.getTreeSize(), 2u);
+}
@@ -0,0 +1,162 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include "tabularpcn/utils/sgf_writer.hpp"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> generatedInputs()
+{
+    SGFGenerator generator(21);
+    return {
+        generator.mixed(3000),
+        generator.wideOrRoot(16, 20),
+        generator.deepLine(2000),
+        generator.commentHeavy(200, 300),
+        generator.transpositionHeavy(6, 4),
+        "(;B[aa])",
+        "(;B[aa](;W[bb])(;W[cc])(;W[dd];B[ee](;W[ff])(;W[gg])))",
+    };
+}
+
+// the recursive toSgf the writer replaced, to check that the output did not change
+void baselineNode(const SGFTreeNode& node, std::ostringstream& oss)
+{
+    oss << ";";
+    node.forEachProperty([&](std::string_view tag, const std::vector<std::string_view>& values) {
+        oss << tag;
+        if (tag != "C") {
+            for (const auto& value : values) {
+                oss << "[" << value << "]";
+            }
+        } else {
+            oss << "[" << values[0] << "\n"
+                << "id = " << node.id_ << "\n"
+                << "type = " << TreeNode::typeToString(node.type_) << "\n"
+                << "tree_size = " << node.tree_size_ << "\n"
+                << "proof_tree_size = " << node.proof_tree_size_ << "\n"
+                << "solved = " << (node.solved_ ? "true" : "false") << "\n"
+                << "match_tt = " << (node.match_tt_ ? "true" : "false") << "\n"
+                << "pruned_by_rzone = " << (node.pruned_by_rzone_ ? "true" : "false") << "]";
+        }
+    });
+}
+
+void baselineSgf(const SGFTreeNode& node, std::ostringstream& oss, bool root)
+{
+    if (root) { oss << "("; }
+    const SGFTreeNode* child = static_cast<const SGFTreeNode*>(node.child_);
+    const SGFTreeNode* sibling = static_cast<const SGFTreeNode*>(node.next_sibling_);
+    if (sibling) {
+        oss << "(";
+        baselineNode(node, oss);
+        if (child) { baselineSgf(*child, oss, false); }
+        if (sibling->next_sibling_) {
+            oss << ")";
+            baselineSgf(*sibling, oss, false);
+        } else {
+            oss << ")(";
+            baselineSgf(*sibling, oss, false);
+            oss << ")";
+        }
+    } else {
+        baselineNode(node, oss);
+        if (child) { baselineSgf(*child, oss, false); }
+    }
+    if (root) { oss << ")"; }
+}
+
+std::string baselineSgf(const SGFTreeNode* root)
+{
+    std::ostringstream oss;
+    baselineSgf(*root, oss, true);
+    return oss.str();
+}
+
+// `reloaded` is `original` written and loaded again: same structure and flags, comments with the annotations appended
+void expectSameAnnotatedTree(const SGFTreeNode* original, const SGFTreeNode* reloaded)
+{
+    std::vector<std::pair<const SGFTreeNode*, const SGFTreeNode*>> stack = {{original, reloaded}};
+    while (!stack.empty()) {
+        auto [a, b] = stack.back();
+        stack.pop_back();
+        ASSERT_EQ(a->properties_.size(), b->properties_.size()) << a->toSgfString();
+        for (size_t p = 0; p < a->properties_.size(); ++p) {
+            const auto& [tag, values] = a->properties_[p];
+            ASSERT_EQ(tag, b->properties_[p].first);
+            if (tag != "C") {
+                EXPECT_EQ(values, b->properties_[p].second);
+            } else {
+                ASSERT_EQ(b->properties_[p].second.size(), 1u);
+                EXPECT_EQ(b->properties_[p].second[0].rfind(values[0] + "\nid = ", 0), 0u) << b->properties_[p].second[0];
+            }
+        }
+        EXPECT_EQ(a->move_, b->move_);
+        EXPECT_EQ(a->type_, b->type_);
+        EXPECT_EQ(a->solved_, b->solved_);
+        EXPECT_EQ(a->match_tt_, b->match_tt_);
+        EXPECT_EQ(a->tree_size_, b->tree_size_);
+        EXPECT_EQ(a->proof_tree_size_, b->proof_tree_size_);
+        ASSERT_EQ(a->num_children_, b->num_children_);
+        const BaseTreeNode* child_b = b->child_;
+        for (const BaseTreeNode* child_a = a->child_; child_a != nullptr; child_a = child_a->next_sibling_, child_b = child_b->next_sibling_) {
+            stack.emplace_back(static_cast<const SGFTreeNode*>(child_a), static_cast<const SGFTreeNode*>(child_b));
+        }
+    }
+}
+
+std::string readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+TEST(SGFWriterTest, OutputMatchesRecursiveToSgf)
+{
+    for (const std::string& sgf : generatedInputs()) {
+        auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(sgf);
+        std::string expected = baselineSgf(tree.getRootNode());
+        EXPECT_EQ(tree.getRootNode()->toSgf(), expected);
+
+        std::string appended = "(;B[zz])";
+        SGFWriter(appended).write(tree.getRootNode());
+        EXPECT_EQ(appended, "(;B[zz])" + expected);
+    }
+}
+
+TEST(SGFWriterTest, ChunkedFileOutputMatchesString)
+{
+    std::string path = ::testing::TempDir() + "tabularpcn_writer_" + std::to_string(::getpid()) + ".sgf";
+    for (const std::string& sgf : generatedInputs()) {
+        auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(sgf);
+        std::string expected = tree.getRootNode()->toSgf();
+        // chunks smaller than a token, than a comment, and larger than the output
+        for (size_t chunk_size : {size_t(1), size_t(7), size_t(100), size_t(4096), SGFWriter::DEFAULT_CHUNK_SIZE}) {
+            SGFWriter::writeFile(tree.getRootNode(), path, chunk_size);
+            ASSERT_EQ(readFile(path), expected) << "chunks of " << chunk_size;
+        }
+    }
+    std::remove(path.c_str());
+    EXPECT_THROW(SGFWriter::writeFile(SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa])").getRootNode(), ::testing::TempDir() + "missing/dir/out.sgf"), std::invalid_argument);
+}
+
+TEST(SGFWriterTest, WrittenTreesLoadBack)
+{
+    for (const std::string& sgf : generatedInputs()) {
+        auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(sgf);
+        std::string written = tree.getRootNode()->toSgf();
+        auto reloaded = SGFTreeLoader<SGFTreeNode>().loadFromString(written);
+        ASSERT_EQ(reloaded.getTreeSize(), tree.getTreeSize());
+        expectSameAnnotatedTree(tree.getRootNode(), reloaded.getRootNode());
+    }
+}
@@ -0,0 +1,131 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/tree/subtree_index.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using Index = SubtreeIndex<SGFTreeNode>::Index;
+
+namespace {
+
+// the ancestors of a node from itself up to the root, by walking the parent pointers of the tree
+std::vector<Index> ancestors(const SubtreeIndex<SGFTreeNode>& index, Index i)
+{
+    std::vector<Index> path;
+    for (const BaseTreeNode* node = index.node(i); node != nullptr; node = node->parent_) {
+        path.push_back(index.indexOf(static_cast<const SGFTreeNode*>(node)));
+    }
+    return path;
+}
+
+Index bruteForceLca(const SubtreeIndex<SGFTreeNode>& index, Index a, Index b)
+{
+    std::vector<Index> path_a = ancestors(index, a);
+    std::vector<Index> path_b = ancestors(index, b);
+    Index lca = SubtreeIndex<SGFTreeNode>::NONE;
+    for (auto it_a = path_a.rbegin(), it_b = path_b.rbegin(); it_a != path_a.rend() && it_b != path_b.rend() && *it_a == *it_b; ++it_a, ++it_b) {
+        lca = *it_a;
+    }
+    return lca;
+}
+
+void expectMatchesParentWalk(const std::string& sgf)
+{
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(sgf);
+    SubtreeIndex<SGFTreeNode> index;
+    SGFTreeLoader<SGFTreeNode>::dfsTreeSize(tree, index);
+    ASSERT_EQ(index.size(), tree.getTreeSize());
+
+    std::vector<std::vector<Index>> paths;
+    for (Index i = 0; i < index.size(); ++i) {
+        paths.push_back(ancestors(index, i));
+        ASSERT_EQ(index.indexOf(index.node(i)), i);
+        EXPECT_EQ(index.depth(i), paths[i].size() - 1);
+        EXPECT_EQ(index.subtreeEnd(i) - i, index.node(i)->tree_size_);
+        for (size_t k = 0; k < paths[i].size(); ++k) {
+            ASSERT_EQ(index.ancestor(i, k), paths[i][k]) << "node " << i << ", k " << k;
+        }
+        EXPECT_EQ(index.ancestor(i, paths[i].size()), SubtreeIndex<SGFTreeNode>::NONE);
+    }
+    for (Index a = 0; a < index.size(); ++a) {
+        for (Index b = 0; b < index.size(); ++b) {
+            bool is_ancestor = std::find(paths[b].begin(), paths[b].end(), a) != paths[b].end();
+            ASSERT_EQ(index.contains(a, b), is_ancestor) << a << " " << b;
+            ASSERT_EQ(index.contains(index.node(a), index.node(b)), is_ancestor) << a << " " << b;
+            ASSERT_EQ(index.lca(a, b), bruteForceLca(index, a, b)) << a << " " << b;
+        }
+    }
+}
+
+} // namespace
+
+TEST(SubtreeIndexTest, RandomTreesMatchParentWalk)
+{
+    for (uint64_t seed = 1; seed <= 5; ++seed) {
+        SGFGenerator generator(seed);
+        expectMatchesParentWalk(generator.mixed(200 + 40 * seed));
+        expectMatchesParentWalk(generator.transpositionHeavy(5, 3));
+    }
+    SGFGenerator generator(9);
+    expectMatchesParentWalk(generator.deepLine(300));
+    expectMatchesParentWalk(generator.wideOrRoot(20, 3));
+    expectMatchesParentWalk("(;B[aa])");
+}
+
+TEST(SubtreeIndexTest, UnindexedNodesAreNotContained)
+{
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa](;W[bb])(;W[cc]))");
+    SubtreeIndex<SGFTreeNode> index;
+    SGFTreeLoader<SGFTreeNode>::dfsTreeSize(tree, index);
+    SGFTreeNode other;
+    EXPECT_EQ(index.indexOf(&other), SubtreeIndex<SGFTreeNode>::NONE);
+    EXPECT_FALSE(index.contains(tree.getRootNode(), &other));
+    EXPECT_EQ(index.lca(tree.getRootNode(), &other), nullptr);
+}
+
+TEST(SubtreeIndexTest, DeepChainQueriesAreLogarithmic)
+{
+    const Index depth = 100000;
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(SGFGenerator(3).deepLine(depth));
+    SubtreeIndex<SGFTreeNode> index;
+    SGFTreeLoader<SGFTreeNode>::dfsTreeSize(tree, index);
+    ASSERT_EQ(index.size(), depth);
+
+    std::mt19937_64 random(5);
+    auto start = std::chrono::steady_clock::now();
+    for (Index i = 0; i < depth; ++i) {
+        ASSERT_EQ(index.ancestor(i, i), 0u);
+        Index k = static_cast<Index>(random() % (i + 1));
+        ASSERT_EQ(index.ancestor(i, k), i - k);
+        Index j = static_cast<Index>(random() % depth);
+        ASSERT_EQ(index.lca(i, j), std::min(i, j));
+    }
+    // a parent walk per query takes billions of steps here
+    EXPECT_LT(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1.0);
+}
+
+TEST(SubtreeIndexTest, LcaOfDeepBranchesIsLogarithmic)
+{
+    // two chains below the root, so every lca climbs from one chain to the root
+    const Index depth = 50000;
+    SGFGenerator generator(4);
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa]" + generator.deepLine(depth) + generator.deepLine(depth) + ")");
+    SubtreeIndex<SGFTreeNode> index;
+    SGFTreeLoader<SGFTreeNode>::dfsTreeSize(tree, index);
+    ASSERT_EQ(index.size(), 2 * depth + 1);
+
+    std::mt19937_64 random(6);
+    auto start = std::chrono::steady_clock::now();
+    for (Index i = 1; i <= depth; ++i) {
+        Index j = depth + 1 + static_cast<Index>(random() % depth);
+        ASSERT_EQ(index.lca(i, j), 0u);
+        ASSERT_EQ(index.lca(j, i), 0u);
+        Index k = 1 + static_cast<Index>(random() % depth);
+        ASSERT_EQ(index.lca(i, k), std::min(i, k));
+    }
+    EXPECT_LT(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1.0);
+}
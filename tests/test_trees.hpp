@@ -0,0 +1,64 @@
+#pragma once
+
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include <string>
+
+/**
+ * @brief Preorder dump of a subtree with the properties, flags and sizes of every node, to compare two loads.
+ *
+ * Node ids are left out, they depend on the allocation order.
+ */
+template <typename NodeType>
+void dumpTree(const NodeType* node, std::string& out)
+{
+    node->forEachProperty([&out](std::string_view tag, const std::vector<std::string_view>& values) {
+        out += tag;
+        for (std::string_view value : values) {
+            out += '[';
+            out += value;
+            out += ']';
+        }
+    });
+    out += ' ' + TreeNode::typeToString(node->type_);
+    out += node->solved_ ? " solved" : "";
+    out += node->match_tt_ ? " match_tt" : "";
+    out += ' ' + std::to_string(node->tree_size_) + '/' + std::to_string(node->proof_tree_size_) + '\n';
+    for (const BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+        out += '(';
+        dumpTree(static_cast<const NodeType*>(child), out);
+        out += ")\n";
+    }
+}
+
+template <typename NodeType>
+std::string dumpTree(const NodeType* root)
+{
+    std::string out;
+    if (root != nullptr) {
+        dumpTree(root, out);
+    }
+    return out;
+}
+
+/**
+ * @brief Number of nodes of an SGF text, i.e. of ';' outside property values.
+ */
+inline size_t countNodes(const std::string& sgf)
+{
+    size_t count = 0;
+    bool in_value = false;
+    bool escaped = false;
+    for (char c : sgf) {
+        if (escaped) {
+            escaped = false;
+        } else if (in_value) {
+            escaped = c == '\\';
+            in_value = c != ']';
+        } else if (c == '[') {
+            in_value = true;
+        } else if (c == ';') {
+            ++count;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,165 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include "tabularpcn/utils/training_table.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const char* const COLUMNS[] = {"position_key", "parent", "type", "solved", "tree_size", "proof_tree_size", "log_tree_size", "log_proof_tree_size"};
+
+// a one-dimensional .npy file of version 1.0, checking its header the way numpy.load reads it
+template <typename T>
+std::vector<T> readNpy(const std::string& path, const std::string& descr)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_GE(bytes.size(), 10u) << path;
+    if (bytes.size() < 10) {
+        return {};
+    }
+    EXPECT_EQ(bytes.substr(0, 8), std::string("\x93NUMPY\x01\x00", 8)) << path;
+    size_t header_size = static_cast<uint8_t>(bytes[8]) | static_cast<uint8_t>(bytes[9]) << 8;
+    size_t data_offset = 10 + header_size;
+    EXPECT_EQ(data_offset % 64, 0u) << path; // the data is aligned for memory mapping
+    EXPECT_LE(data_offset, bytes.size()) << path;
+    std::string header = bytes.substr(10, header_size);
+    EXPECT_EQ(header.back(), '\n') << path;
+
+    // {'descr': '<u4', 'fortran_order': False, 'shape': (N,), } padded with spaces
+    std::string prefix = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (";
+    EXPECT_EQ(header.compare(0, prefix.size(), prefix), 0) << header;
+    size_t shape_end = header.find(",), }", prefix.size());
+    EXPECT_NE(shape_end, std::string::npos) << header;
+    if (header.compare(0, prefix.size(), prefix) != 0 || shape_end == std::string::npos) {
+        return {};
+    }
+    size_t count = std::stoull(header.substr(prefix.size(), shape_end - prefix.size()));
+    EXPECT_EQ(header.find_first_not_of(' ', shape_end + 5), header.size() - 1) << header;
+    EXPECT_EQ(bytes.size(), data_offset + count * sizeof(T)) << path;
+
+    std::vector<T> values(count);
+    std::memcpy(values.data(), bytes.data() + data_offset, std::min(count * sizeof(T), bytes.size() - data_offset));
+    return values;
+}
+
+// the key of every node in preorder, computed along the tree
+void positionKeys(const SGFTreeNode* node, SGFPositionHash::Path path, std::vector<uint64_t>& keys)
+{
+    path = path.extend(node->type_, node->move_);
+    keys.push_back(SGFPositionHash::positionKey(path.hash, node->type_));
+    for (const BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+        positionKeys(static_cast<const SGFTreeNode*>(child), path, keys);
+    }
+}
+
+class TrainingTableExporterTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        directory_ = ::testing::TempDir() + "tabularpcn_table_" + std::to_string(::getpid());
+    }
+
+    void TearDown() override
+    {
+        for (const char* column : COLUMNS) {
+            std::remove((directory_ + "/" + column + ".npy").c_str());
+        }
+        ::rmdir(directory_.c_str());
+    }
+
+    template <typename T>
+    std::vector<T> column(const std::string& name, const std::string& descr) const
+    {
+        return readNpy<T>(directory_ + "/" + name + ".npy", descr);
+    }
+
+    std::string directory_;
+};
+
+} // namespace
+
+TEST_F(TrainingTableExporterTest, ColumnsReadBackAsTheTree)
+{
+    auto loaded = SGFTreeLoader<SGFTreeNode>().loadFromString(SGFGenerator(14).mixed(3000));
+    CompactTree tree = CompactTree::build(loaded.getRootNode());
+    std::vector<uint64_t> keys;
+    positionKeys(loaded.getRootNode(), SGFPositionHash::Path(), keys);
+
+    for (size_t num_threads : {1, 4}) {
+        ASSERT_EQ(TrainingTableExporter::write(loaded.getRootNode(), directory_, num_threads), tree.size());
+        EXPECT_EQ(column<uint64_t>("position_key", "<u8"), keys);
+        EXPECT_EQ(column<uint32_t>("parent", "<u4"), tree.parent_);
+        EXPECT_EQ(column<uint32_t>("tree_size", "<u4"), tree.tree_size_);
+        EXPECT_EQ(column<uint32_t>("proof_tree_size", "<u4"), tree.proof_tree_size_);
+        EXPECT_EQ(column<uint8_t>("solved", "|u1"), tree.solved_);
+
+        std::vector<int8_t> types = column<int8_t>("type", "|i1");
+        ASSERT_EQ(types.size(), tree.size());
+        std::vector<float> log_sizes = column<float>("log_tree_size", "<f4");
+        std::vector<float> log_proof_sizes = column<float>("log_proof_tree_size", "<f4");
+        ASSERT_EQ(log_sizes.size(), tree.size());
+        ASSERT_EQ(log_proof_sizes.size(), tree.size());
+        for (CompactTree::Index i = 0; i < tree.size(); ++i) {
+            EXPECT_EQ(types[i], static_cast<int8_t>(tree.type_[i]));
+            EXPECT_FLOAT_EQ(log_sizes[i], std::log1p(tree.tree_size_[i]));
+            EXPECT_FLOAT_EQ(log_proof_sizes[i], std::log1p(tree.proof_tree_size_[i]));
+        }
+    }
+    EXPECT_EQ(column<uint32_t>("parent", "<u4")[0], CompactTree::NONE);
+}
+
+TEST_F(TrainingTableExporterTest, DedupKeepsTheLargestSubtreeOfEveryPosition)
+{
+    auto loaded = SGFTreeLoader<SGFTreeNode>().loadFromString(SGFGenerator(15).transpositionHeavy(6, 4));
+    CompactTree tree = CompactTree::build(loaded.getRootNode());
+    std::vector<uint64_t> keys;
+    positionKeys(loaded.getRootNode(), SGFPositionHash::Path(), keys);
+    std::map<uint64_t, uint32_t> largest; // position key -> largest tree_size_
+    for (CompactTree::Index i = 0; i < tree.size(); ++i) {
+        largest[keys[i]] = std::max(largest[keys[i]], tree.tree_size_[i]);
+    }
+    ASSERT_LT(largest.size(), tree.size()); // there are transpositions to remove
+
+    ASSERT_EQ(TrainingTableExporter::write(loaded.getRootNode(), directory_, 2, true), largest.size());
+    std::vector<uint64_t> row_keys = column<uint64_t>("position_key", "<u8");
+    std::vector<uint32_t> parents = column<uint32_t>("parent", "<u4");
+    std::vector<uint32_t> sizes = column<uint32_t>("tree_size", "<u4");
+    ASSERT_EQ(row_keys.size(), largest.size());
+    ASSERT_EQ(parents.size(), largest.size());
+    ASSERT_EQ(sizes.size(), largest.size());
+    std::map<uint64_t, size_t> row_of;
+    for (size_t r = 0; r < row_keys.size(); ++r) {
+        EXPECT_TRUE(row_of.emplace(row_keys[r], r).second) << "position " << row_keys[r] << " twice";
+        EXPECT_EQ(sizes[r], largest[row_keys[r]]);
+    }
+
+    // the parent of a row is the row kept for the position of the parent of some node at the row's position
+    EXPECT_EQ(parents[0], CompactTree::NONE);
+    std::set<uint64_t> matched = {row_keys[0]};
+    for (CompactTree::Index i = 1; i < tree.size(); ++i) {
+        if (tree.tree_size_[i] == largest.at(keys[i]) && parents[row_of.at(keys[i])] == row_of.at(keys[tree.parent_[i]])) {
+            matched.insert(keys[i]);
+        }
+    }
+    EXPECT_EQ(matched.size(), largest.size());
+}
+
+TEST_F(TrainingTableExporterTest, UnwritableDirectoriesThrow)
+{
+    auto loaded = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa];W[bb])");
+    EXPECT_THROW(TrainingTableExporter::write(loaded.getRootNode(), directory_ + "/missing/table"), std::invalid_argument);
+    EXPECT_THROW(TrainingTableExporter::writeNpy(directory_ + "/missing/column.npy", std::vector<uint32_t>{1, 2}), std::invalid_argument);
+}
@@ -0,0 +1,169 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/tree/tree_size_maintainer.hpp"
+#include "tabularpcn/utils/sgf_tree_loader.hpp"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::vector<SGFTreeNode*> preorder(SGFTreeNode* root)
+{
+    std::vector<SGFTreeNode*> nodes;
+    std::vector<SGFTreeNode*> stack = {root};
+    while (!stack.empty()) {
+        SGFTreeNode* node = stack.back();
+        stack.pop_back();
+        nodes.push_back(node);
+        for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+            stack.push_back(static_cast<SGFTreeNode*>(child));
+        }
+    }
+    return nodes;
+}
+
+// whether every node has the sizes that a full dfsTreeSize computes
+void expectSizesOfFullRecompute(SGFTreeNode* root, const std::string& edit)
+{
+    std::vector<SGFTreeNode*> nodes = preorder(root);
+    std::vector<std::pair<size_t, size_t>> maintained;
+    for (SGFTreeNode* node : nodes) {
+        maintained.emplace_back(node->tree_size_, node->proof_tree_size_);
+    }
+    SGFTreeLoader<SGFTreeNode>::dfsTreeSize(root);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        ASSERT_EQ(maintained[i], std::make_pair(nodes[i]->tree_size_, nodes[i]->proof_tree_size_)) << "node " << i << " after " << edit;
+    }
+}
+
+// the solved child with the smallest proof of an OR node, nullptr if there is none
+SGFTreeNode* minimumChild(SGFTreeNode* node)
+{
+    SGFTreeNode* best = nullptr;
+    for (BaseTreeNode* child = node->child_; child != nullptr; child = child->next_sibling_) {
+        SGFTreeNode* child_node = static_cast<SGFTreeNode*>(child);
+        if (child_node->solved_ && (best == nullptr || child_node->proof_tree_size_ < best->proof_tree_size_)) {
+            best = child_node;
+        }
+    }
+    return best;
+}
+
+bool isAncestor(const BaseTreeNode* ancestor, const BaseTreeNode* node)
+{
+    for (; node != nullptr; node = node->parent_) {
+        if (node == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+TEST(TreeSizeMaintainerTest, RandomEditsMatchFullRecompute)
+{
+    for (uint64_t seed = 1; seed <= 4; ++seed) {
+        auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString(SGFGenerator(seed).mixed(600));
+        SGFTreeNode* root = tree.getRootNode();
+        TreeSizeMaintainer<SGFTreeNode> maintainer;
+        std::vector<SGFTreeNode*> detached; // pruned subtrees, their sizes stay valid on their own
+        std::mt19937_64 random(seed);
+        size_t num_min_prunes = 0;
+        size_t num_unsolves = 0;
+
+        for (int step = 0; step < 1500; ++step) {
+            std::vector<SGFTreeNode*> nodes = preorder(root);
+            SGFTreeNode* node = nodes[random() % nodes.size()];
+            std::string edit;
+            switch (random() % 6) {
+                case 0: // prune the child at the minimum of an OR node
+                    if (node->solved_ && node->type_ == TreeNode::Type::OR && minimumChild(node) != nullptr) {
+                        SGFTreeNode* child = minimumChild(node);
+                        maintainer.prune(child);
+                        detached.push_back(child);
+                        edit = "pruning a minimum";
+                        ++num_min_prunes;
+                        break;
+                    }
+                    [[fallthrough]];
+                case 1:
+                    if (node != root) {
+                        maintainer.prune(node);
+                        detached.push_back(node);
+                        edit = "pruning";
+                    }
+                    break;
+                case 2:
+                    if (!detached.empty()) {
+                        size_t k = random() % detached.size();
+                        maintainer.graft(node, detached[k]);
+                        detached.erase(detached.begin() + k);
+                        edit = "grafting";
+                    }
+                    break;
+                case 3: { // move an attached subtree
+                    SGFTreeNode* subtree = nodes[random() % nodes.size()];
+                    if (subtree != root && !isAncestor(subtree, node)) {
+                        maintainer.graft(node, subtree);
+                        edit = "moving";
+                    }
+                    break;
+                }
+                case 4: { // a new leaf
+                    SGFTreeNode* leaf = tree.createNode();
+                    leaf->type_ = random() % 2 == 0 ? TreeNode::Type::OR : TreeNode::Type::AND;
+                    leaf->solved_ = random() % 2 == 0;
+                    leaf->tree_size_ = 1;
+                    leaf->proof_tree_size_ = leaf->solved_ ? 1 : 0;
+                    maintainer.graft(node, leaf);
+                    edit = "grafting a leaf";
+                    break;
+                }
+                default: // solve or unsolve
+                    num_unsolves += node->solved_;
+                    node->solved_ = !node->solved_;
+                    maintainer.refresh(node);
+                    edit = node->solved_ ? "solving" : "unsolving";
+                    break;
+            }
+            expectSizesOfFullRecompute(root, edit);
+            if (::testing::Test::HasFatalFailure()) {
+                return;
+            }
+        }
+        EXPECT_GT(num_min_prunes, 10u);
+        EXPECT_GT(num_unsolves, 10u);
+    }
+}
+
+TEST(TreeSizeMaintainerTest, PruningTheMinimumRescansTheOrNode)
+{
+    const std::string WIN = "C[solver_status: WIN\nmatch_tt = false\nequal_loss = 0]";
+    // the root (B, OR) has solved children with proofs of 1, 1 and 2 nodes
+    auto tree = SGFTreeLoader<SGFTreeNode>().loadFromString("(;B[aa]" + WIN + "(;W[bb]" + WIN + ")(;W[cc]" + WIN + ")(;W[dd]" + WIN + ";B[ee]" + WIN + "))");
+    SGFTreeNode* root = tree.getRootNode();
+    ASSERT_EQ(root->proof_tree_size_, 2u);
+    TreeSizeMaintainer<SGFTreeNode> maintainer;
+    SGFTreeNode* first = static_cast<SGFTreeNode*>(root->child_);
+    SGFTreeNode* second = static_cast<SGFTreeNode*>(first->next_sibling_);
+
+    maintainer.prune(first);
+    EXPECT_EQ(root->proof_tree_size_, 2u); // the other child still reaches the minimum
+    maintainer.prune(second);
+    EXPECT_EQ(root->proof_tree_size_, 3u);
+    EXPECT_EQ(root->tree_size_, 3u);
+
+    maintainer.graft(root, first);
+    EXPECT_EQ(root->proof_tree_size_, 2u);
+    first->solved_ = false;
+    maintainer.refresh(first);
+    EXPECT_EQ(first->proof_tree_size_, 0u);
+    EXPECT_EQ(root->proof_tree_size_, 3u);
+    root->solved_ = false;
+    maintainer.refresh(root);
+    EXPECT_EQ(root->proof_tree_size_, 0u);
+    EXPECT_EQ(root->tree_size_, 4u);
+}
@@ -0,0 +1,171 @@
+#include "sgf_generators.hpp"
+#include "tabularpcn/utils/tree_snapshot.hpp"
+#include "test_trees.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+class TreeSnapshotTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        path_ = ::testing::TempDir() + "tabularpcn_snapshot_" + std::to_string(::getpid()) + ".bin";
+        tree_ = SGFTreeLoader<SGFTreeNode>().loadFromString(SGFGenerator(5).mixed(2000));
+    }
+
+    void TearDown() override
+    {
+        std::remove(path_.c_str());
+    }
+
+    // every field of the snapshot, to compare snapshots read from different places
+    static std::string dumpSnapshot(const TreeSnapshot& snapshot)
+    {
+        std::string out;
+        for (TreeSnapshot::Index i = 0; i < snapshot.size(); ++i) {
+            out += std::to_string(snapshot.parent(i)) + ' ' + std::to_string(snapshot.treeSize(i)) + ' ' + std::to_string(snapshot.proofTreeSize(i)) + ' ' + std::to_string(snapshot.flags(i));
+            for (uint64_t p = snapshot.propertyBegin(i); p < snapshot.propertyEnd(i); ++p) {
+                out += ' ';
+                out += snapshot.tag(p);
+                for (uint64_t v = snapshot.valueBegin(p); v < snapshot.valueEnd(p); ++v) {
+                    out += '[';
+                    out += snapshot.value(v);
+                    out += ']';
+                }
+            }
+            out += '\n';
+        }
+        return out;
+    }
+
+    // the bytes of the snapshot of tree_
+    std::string snapshotBytes()
+    {
+        TreeSnapshot::write(tree_.getRootNode(), path_);
+        std::ifstream file(path_, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    std::string openError(const std::string& bytes)
+    {
+        std::ofstream(path_, std::ios::binary) << bytes;
+        try {
+            TreeSnapshot::open(path_);
+        } catch (const std::runtime_error& error) {
+            return error.what();
+        }
+        return "";
+    }
+
+    // header fields at their offsets in TreeSnapshot::Header
+    static constexpr size_t NUM_NODES = 16;
+    static constexpr size_t POOL_SIZE = 40;
+    static size_t sectionField(int section) { return 48 + 8 * section; }
+
+    static uint64_t get(const std::string& bytes, size_t offset)
+    {
+        uint64_t value;
+        std::memcpy(&value, &bytes[offset], sizeof(value));
+        return value;
+    }
+
+    static void set(std::string& bytes, size_t offset, uint64_t value, size_t size = sizeof(uint64_t))
+    {
+        std::memcpy(&bytes[offset], &value, size); // little-endian prefix for size < 8, as the tests run on
+    }
+
+    std::string path_;
+    Tree<SGFTreeNode> tree_;
+};
+
+} // namespace
+
+TEST_F(TreeSnapshotTest, FileRoundTrip)
+{
+    TreeSnapshot::write(tree_.getRootNode(), path_);
+    TreeSnapshot snapshot = TreeSnapshot::open(path_);
+    ASSERT_EQ(snapshot.size(), tree_.getTreeSize());
+    EXPECT_EQ(snapshot.treeSize(0), tree_.getRootNode()->tree_size_);
+    EXPECT_EQ(snapshot.proofTreeSize(0), tree_.getRootNode()->proof_tree_size_);
+    EXPECT_EQ(dumpTree(snapshot.toTree<SGFTreeNode>().getRootNode()), dumpTree(tree_.getRootNode()));
+    EXPECT_EQ(dumpTree((snapshot.toTree<SGFTreeNode, ArenaTree<SGFTreeNode>>().getRootNode())), dumpTree(tree_.getRootNode()));
+}
+
+TEST_F(TreeSnapshotTest, SharedSnapshotMatchesFile)
+{
+    TreeSnapshot::write(tree_.getRootNode(), path_);
+    TreeSnapshot file = TreeSnapshot::open(path_);
+    TreeSnapshot shared = TreeSnapshot::share(tree_.getRootNode());
+    EXPECT_EQ(dumpSnapshot(shared), dumpSnapshot(file));
+    EXPECT_EQ(dumpTree(shared.toTree<SGFTreeNode>().getRootNode()), dumpTree(tree_.getRootNode()));
+
+    TreeSnapshot copy = shared;
+    shared = TreeSnapshot(); // copies keep the mapping
+    EXPECT_EQ(dumpSnapshot(copy), dumpSnapshot(file));
+}
+
+TEST_F(TreeSnapshotTest, ForkedWorkersReadSharedSnapshot)
+{
+    TreeSnapshot shared = TreeSnapshot::share(tree_.getRootNode());
+    std::string expected = dumpSnapshot(shared);
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::_exit(dumpSnapshot(shared) == expected ? 0 : 1);
+    }
+    ASSERT_GT(pid, 0);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST_F(TreeSnapshotTest, RejectsFilesThatAreNotSnapshots)
+{
+    {
+        std::ofstream file(path_);
+        file << "(;B[aa])";
+    }
+    EXPECT_THROW(TreeSnapshot::open(path_), std::runtime_error);
+}
+
+TEST_F(TreeSnapshotTest, RejectsCorruptSnapshots)
+{
+    const std::string bytes = snapshotBytes();
+    ASSERT_EQ(openError(bytes), "");
+    const int parent = 0, first_child = 1, node_property_begin = 8, value = 11;
+    const uint64_t num_nodes = get(bytes, NUM_NODES);
+
+    EXPECT_EQ(openError(bytes.substr(0, bytes.size() - 1)), "Invalid tree snapshot: section out of bounds");
+
+    std::string corrupt = bytes;
+    set(corrupt, NUM_NODES, uint64_t(1) << 62); // the section sizes would overflow
+    EXPECT_EQ(openError(corrupt), "Invalid tree snapshot: counts out of bounds");
+
+    corrupt = bytes;
+    set(corrupt, get(bytes, sectionField(parent)) + 4 * 3, 7, 4); // node 3 before its parent
+    EXPECT_EQ(openError(corrupt), "Invalid tree snapshot: node 3 links out of bounds");
+
+    corrupt = bytes;
+    set(corrupt, get(bytes, sectionField(first_child)), num_nodes, 4);
+    EXPECT_EQ(openError(corrupt), "Invalid tree snapshot: node 0 links out of bounds");
+
+    corrupt = bytes;
+    set(corrupt, get(bytes, sectionField(node_property_begin)) + 8 * num_nodes, get(bytes, sectionField(node_property_begin)) + 1);
+    EXPECT_EQ(openError(corrupt), "Invalid tree snapshot: ranges out of bounds");
+
+    corrupt = bytes;
+    set(corrupt, get(bytes, sectionField(node_property_begin)) + 8, uint64_t(1) << 40);
+    EXPECT_EQ(openError(corrupt), "Invalid tree snapshot: ranges out of order");
+
+    corrupt = bytes;
+    set(corrupt, get(bytes, sectionField(value)), get(bytes, POOL_SIZE)); // offset at the end of the pool, size 1 or more
+    set(corrupt, get(bytes, sectionField(value)) + 8, uint64_t(-1));
+    EXPECT_EQ(openError(corrupt), "Invalid tree snapshot: string out of bounds");
+}